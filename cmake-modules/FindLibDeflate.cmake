@@ -0,0 +1,36 @@
+# - Try to find the libdeflate library
+#
+# Once done this will define
+#
+#  LIBDEFLATE_FOUND - system has libdeflate
+#  LIBDEFLATE_INCLUDE_DIR - the libdeflate include directory
+#  LIBDEFLATE_LIBRARIES - Link these to use libdeflate
+#  LIBDEFLATE_DEFINITIONS - Compiler switches required for using libdeflate
+
+if (NOT WIN32)
+   # use pkg-config to get the directories and then use these values
+   # in the FIND_PATH() and FIND_LIBRARY() calls
+   find_package(PkgConfig)
+   pkg_check_modules(PC_LIBDEFLATE QUIET libdeflate)
+   set(LIBDEFLATE_DEFINITIONS ${PC_LIBDEFLATE_CFLAGS_OTHER})
+endif (NOT WIN32)
+
+
+find_path(LIBDEFLATE_INCLUDE_DIR NAMES libdeflate.h
+          HINTS
+          ${PC_LIBDEFLATE_INCLUDEDIR}
+          ${PC_LIBDEFLATE_INCLUDE_DIRS}
+        )
+
+find_library(LIBDEFLATE_LIBRARY NAMES deflate libdeflate
+             HINTS
+             ${PC_LIBDEFLATE_LIBDIR}
+             ${PC_LIBDEFLATE_LIBRARY_DIRS}
+            )
+
+set(LIBDEFLATE_LIBRARIES "${LIBDEFLATE_LIBRARY}")
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibDeflate  REQUIRED_VARS  LIBDEFLATE_LIBRARY LIBDEFLATE_INCLUDE_DIR)
+
+mark_as_advanced(LIBDEFLATE_INCLUDE_DIR LIBDEFLATE_LIBRARY)
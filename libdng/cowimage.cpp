@@ -0,0 +1,164 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "cowimage.h"
+
+#include "dng_bottlenecks.h"
+#include "dng_memory.h"
+#include "dng_orientation.h"
+#include "dng_tag_types.h"
+
+
+// Interleaved pixel buffer over a newly allocated block (same layout as dng_simple_image)
+static std::shared_ptr<void> allocatePixels(const dng_rect &bounds, uint32 planes, uint32 pixelType,
+                                            dng_memory_allocator &allocator, dng_pixel_buffer &buffer) {
+    uint32 pixelSize = TagTypeSize(pixelType);
+    std::shared_ptr<dng_memory_block> block(allocator.Allocate(bounds.H() * bounds.W() * planes * pixelSize));
+
+    buffer.fArea = bounds;
+    buffer.fPlane = 0;
+    buffer.fPlanes = planes;
+    buffer.fRowStep = planes * bounds.W();
+    buffer.fColStep = planes;
+    buffer.fPlaneStep = 1;
+    buffer.fPixelType = pixelType;
+    buffer.fPixelSize = pixelSize;
+    buffer.fData = block->Buffer();
+
+    return block;
+}
+
+
+CowImage::CowImage(const dng_rect &bounds, uint32 planes, uint32 pixelType, dng_memory_allocator &allocator) :
+    dng_image(bounds, planes, pixelType),
+    m_allocator(allocator)
+{
+    m_pixels = allocatePixels(bounds, planes, pixelType, allocator, m_buffer);
+}
+
+
+CowImage::CowImage(const dng_pixel_buffer &buffer, std::shared_ptr<void> owner, dng_memory_allocator &allocator) :
+    dng_image(buffer.fArea, buffer.fPlanes, buffer.fPixelType),
+    m_pixels(owner),
+    m_buffer(buffer),
+    m_allocator(allocator)
+{}
+
+
+dng_image* CowImage::Clone() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return new CowImage(m_buffer, m_pixels, m_allocator);
+}
+
+
+void CowImage::Unshare() const {
+    if (m_pixels.use_count() <= 1) return;
+
+    dng_pixel_buffer buffer;
+    std::shared_ptr<void> pixels(allocatePixels(m_buffer.fArea, m_buffer.fPlanes, m_buffer.fPixelType, m_allocator, buffer));
+
+    // Dropping planes from interleaved 16-bit data (e.g. LibRaw's 4-plane buffers) has its own kernel
+    if ((m_buffer.fPixelSize == 2) && (m_buffer.fPlaneStep == 1) && (m_buffer.fColStep >= (int32) m_buffer.fPlanes)) {
+        for (int32 row = m_buffer.fArea.t; row < m_buffer.fArea.b; row++)
+            DoExtractPlanes16(m_buffer.ConstPixel_uint16(row, m_buffer.fArea.l), buffer.DirtyPixel_uint16(row, m_buffer.fArea.l),
+                              m_buffer.fArea.W(), m_buffer.fColStep, m_buffer.fPlanes);
+    }
+    else buffer.CopyArea(m_buffer, m_buffer.fArea, 0, m_buffer.fPlanes);
+
+    m_pixels = pixels;
+    m_buffer = buffer;
+}
+
+
+void CowImage::GetPixelBuffer(dng_pixel_buffer &buffer) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Unshare();
+    buffer = m_buffer;
+}
+
+
+void CowImage::SetPixelType(uint32 pixelType) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    dng_image::SetPixelType(pixelType);
+    m_buffer.fPixelType = pixelType;
+}
+
+
+// Trim and Rotate only change this image's view of the pixels, as in dng_simple_image
+void CowImage::Trim(const dng_rect &r) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    fBounds.t = 0;
+    fBounds.l = 0;
+    fBounds.b = r.H();
+    fBounds.r = r.W();
+
+    m_buffer.fData = m_buffer.DirtyPixel(r.t, r.l);
+    m_buffer.fArea = fBounds;
+}
+
+
+void CowImage::Rotate(const dng_orientation &orientation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    int32 originH = fBounds.l;
+    int32 originV = fBounds.t;
+    int32 colStep = m_buffer.fColStep;
+    int32 rowStep = m_buffer.fRowStep;
+    uint32 width  = fBounds.W();
+    uint32 height = fBounds.H();
+
+    if (orientation.FlipH()) {
+        originH += width - 1;
+        colStep = -colStep;
+    }
+    if (orientation.FlipV()) {
+        originV += height - 1;
+        rowStep = -rowStep;
+    }
+    if (orientation.FlipD()) {
+        std::swap(colStep, rowStep);
+        width  = fBounds.H();
+        height = fBounds.W();
+    }
+
+    m_buffer.fData = m_buffer.DirtyPixel(originV, originH);
+    m_buffer.fColStep = colStep;
+    m_buffer.fRowStep = rowStep;
+
+    fBounds.r = fBounds.l + width;
+    fBounds.b = fBounds.t + height;
+    m_buffer.fArea = fBounds;
+}
+
+
+void CowImage::AcquireTileBuffer(dng_tile_buffer &buffer, const dng_rect &area, bool dirty) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (dirty) Unshare();
+
+    buffer.fArea = area;
+    buffer.fPlane = m_buffer.fPlane;
+    buffer.fPlanes = m_buffer.fPlanes;
+    buffer.fRowStep = m_buffer.fRowStep;
+    buffer.fColStep = m_buffer.fColStep;
+    buffer.fPlaneStep = m_buffer.fPlaneStep;
+    buffer.fPixelType = m_buffer.fPixelType;
+    buffer.fPixelSize = m_buffer.fPixelSize;
+    buffer.fData = (void*) m_buffer.ConstPixel(area.t, area.l, buffer.fPlane);
+    buffer.fDirty = dirty;
+}
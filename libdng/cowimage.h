@@ -0,0 +1,66 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_image.h"
+#include "dng_pixel_buffer.h"
+
+#include <memory>
+#include <mutex>
+
+/*
+  dng_image whose clones share the pixel memory until one of them is written to.
+
+  Clone() is therefore cheap - dng_negative clones stage 1 to keep the raw image for
+  the DNG, which usually is never modified afterwards. The first write access (a dirty
+  tile buffer or GetPixelBuffer) to an image that shares its pixels copies them first.
+  Pixels can also be memory owned by someone else (e.g. a decoder), which is then kept
+  alive by a shared pointer as long as any image still refers to it.
+*/
+class CowImage : public dng_image {
+public:
+    // New image with its own, uninitialised pixels
+    CowImage(const dng_rect &bounds, uint32 planes, uint32 pixelType, dng_memory_allocator &allocator);
+
+    // Image viewing existing pixels, described by buffer and kept alive by owner
+    CowImage(const dng_pixel_buffer &buffer, std::shared_ptr<void> owner, dng_memory_allocator &allocator);
+
+    virtual ~CowImage() {}
+
+    virtual dng_image* Clone() const;
+
+    virtual void SetPixelType(uint32 pixelType);
+    virtual void Trim(const dng_rect &r);
+    virtual void Rotate(const dng_orientation &orientation);
+
+    // Direct access to the pixels for writing (makes them private to this image first)
+    void GetPixelBuffer(dng_pixel_buffer &buffer);
+
+protected:
+    virtual void AcquireTileBuffer(dng_tile_buffer &buffer, const dng_rect &area, bool dirty) const;
+
+private:
+    // Copies shared pixels, must be called with m_mutex held
+    void Unshare() const;
+
+    mutable std::mutex m_mutex;
+    mutable std::shared_ptr<void> m_pixels;
+    mutable dng_pixel_buffer m_buffer;
+    dng_memory_allocator &m_allocator;
+};
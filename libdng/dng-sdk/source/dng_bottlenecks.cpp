@@ -66,7 +66,8 @@ dng_suite gDNGSuite =
 	RefVignetteMask16,
 	RefVignette16,
 	RefVignette32,
-	RefMapArea16
+	RefMapArea16,
+	RefExtractPlanes16
 	};
 
 /*****************************************************************************/
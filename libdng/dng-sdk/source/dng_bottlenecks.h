@@ -566,6 +566,15 @@ typedef void (MapArea16Proc)
 
 /*****************************************************************************/
 
+typedef void (ExtractPlanes16Proc)
+			 (const uint16 *sPtr,
+			  uint16 *dPtr,
+			  uint32 count,
+			  uint32 sPlanes,
+			  uint32 dPlanes);
+
+/*****************************************************************************/
+
 struct dng_suite	
 	{
 	ZeroBytesProc			*ZeroBytes;
@@ -614,6 +623,7 @@ struct dng_suite
 	Vignette16Proc			*Vignette16;
 	Vignette32Proc			*Vignette32;
 	MapArea16Proc			*MapArea16;
+	ExtractPlanes16Proc		*ExtractPlanes16;
 	};
 
 /*****************************************************************************/
@@ -1710,6 +1720,26 @@ inline void DoMapArea16 (uint16 *dPtr,
 
 /*****************************************************************************/
 
+/// Copies the first dPlanes planes of count pixels with sPlanes interleaved
+/// planes each into pixels with dPlanes interleaved planes (dPlanes <= sPlanes).
+
+inline void DoExtractPlanes16 (const uint16 *sPtr,
+							   uint16 *dPtr,
+							   uint32 count,
+							   uint32 sPlanes,
+							   uint32 dPlanes)
+	{
+	
+	(gDNGSuite.ExtractPlanes16) (sPtr,
+								 dPtr,
+								 count,
+								 sPlanes,
+								 dPlanes);
+
+	}
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
@@ -64,6 +64,10 @@
 #define qAndroidArm7 0
 #endif
 
+#ifndef qLinux
+#define qLinux 0
+#endif
+
 /*****************************************************************************/
 
 // Establish WIN32 and WIN64 definitions.
@@ -188,7 +192,7 @@
 /// 1 if target platform has thread support and threadsafe libraries, 0 otherwise.
 
 #ifndef qDNGThreadSafe
-#define qDNGThreadSafe (qMacOS || qWinOS)
+#define qDNGThreadSafe (qMacOS || qWinOS || qLinux)
 #endif
 
 /*****************************************************************************/
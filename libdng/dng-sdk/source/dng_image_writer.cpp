@@ -2670,6 +2670,25 @@ dng_image_writer::~dng_image_writer ()
 						    
 /*****************************************************************************/
 
+void dng_image_writer::FindRawJPEGTileSize (dng_host & /* host */,
+											dng_ifd &ifd)
+	{
+	
+	ifd.FindTileSize (128 * 1024);
+	
+	}
+						    
+/*****************************************************************************/
+
+uint32 dng_image_writer::LosslessJPEGHuffmanRowStep () const
+	{
+	
+	return 1;
+	
+	}
+						    
+/*****************************************************************************/
+
 uint32 dng_image_writer::CompressedBufferSize (const dng_ifd &ifd,
 											   uint32 uncompressedSize)
 	{
@@ -3867,7 +3886,8 @@ void dng_image_writer::WriteData (dng_host &host,
 								ifd.fBitsPerSample [0],
 								temp.fRowStep,
 								temp.fColStep,
-								stream);
+								stream,
+								LosslessJPEGHuffmanRowStep ());
 										
 			break;
 			
@@ -6134,7 +6154,7 @@ void dng_image_writer::WriteDNG (dng_host &host,
 	else if (info.fCompression == ccJPEG)
 		{
 		
-		info.FindTileSize (128 * 1024);
+		FindRawJPEGTileSize (host, info);
 		
 		}
 		
@@ -1206,6 +1206,19 @@ class dng_image_writer
 		
 	protected:
 	
+		/// Picks the tile size of the raw image, if it is compressed with
+		/// lossless JPEG. The default aims for tiles of about 128 KB.
+		/// \param host Host interface, e.g. for the number of threads used to write.
+		/// \param ifd The IFD of the raw image, with image size and sample format set.
+
+		virtual void FindRawJPEGTileSize (dng_host &host,
+										  dng_ifd &ifd);
+		
+		/// Lossless JPEG Huffman tables are built from every n-th row of a
+		/// tile. The default of 1 counts all rows, for optimal tables.
+
+		virtual uint32 LosslessJPEGHuffmanRowStep () const;
+	
 		virtual uint32 CompressedBufferSize (const dng_ifd &ifd,
 											 uint32 uncompressedSize);
 											 
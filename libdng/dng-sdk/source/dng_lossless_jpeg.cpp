@@ -366,6 +366,18 @@ typedef ComponentType *MCU;  		// MCU - array of samples
 
 /*****************************************************************************/
 
+// The fast decoding tables are indexed with the next kFastHuffBits bits of
+// the stream. Each entry holds the number of bits to flush in its low bits,
+// and either the final difference (if the code and the difference bits both
+// fit, marked by kFastHuffDiff) or the decoded symbol. Zero entries are for
+// codes longer than kFastHuffBits, which take the regular path.
+
+const int32 kFastHuffBits = 12;
+
+const int32 kFastHuffDiff = 0x20;
+
+/*****************************************************************************/
+
 class dng_lossless_decoder
 	{
 	
@@ -379,6 +391,8 @@ class dng_lossless_decoder
 
 		dng_memory_data huffmanBuffer [4];
 		
+		dng_memory_data fastHuffBuffer [4];		// Fast decoding table per Huffman table.
+		
 		dng_memory_data compInfoBuffer;
 		
 		DecompressInfo info;
@@ -470,6 +484,11 @@ class dng_lossless_decoder
 		int32 HuffDecode (HuffmanTable *htbl);
 
 		void HuffExtend (int32 &x, int32 s);
+		
+		void FastHuffInit (int32 tableIndex);
+		
+		int32 DecodeDiff (HuffmanTable *htbl,
+						  const int32 *fastTable);
 
 		void PmPutRow (MCU *buf,
 					   int32 numComp,
@@ -1289,6 +1308,8 @@ void dng_lossless_decoder::HuffDecoderInit ()
 
 		FixHuffTbl (info.dcHuffTblPtrs [compptr->dcTblNo]);
 
+		FastHuffInit (compptr->dcTblNo);
+
 	    }
 
    	// Initialize restart stuff
@@ -1459,14 +1480,19 @@ inline int32 dng_lossless_decoder::QuickPredict (int32 col,
 inline void dng_lossless_decoder::FillBitBuffer (int32 nbits)
 	{
 	
-	const int32 kMinGetBits = sizeof (uint32) * 8 - 7;
+	// Keep the 64 bit buffer as full as possible, so that it needs to be
+	// filled once for several symbols.
+	
+	const int32 kMinGetBits = sizeof (uint64) * 8 - 7;
 	
 	#if qSupportHasselblad_3FR
 	
 	if (fHasselblad3FR)
 		{
 		
-		while (bitsLeft < kMinGetBits)
+		// Filled 32 bits at a time, so stop at 25 bits.
+		
+		while (bitsLeft < (int32) sizeof (uint32) * 8 - 7)
 			{
 			
 			int32 c0 = GetJpegChar ();
@@ -1676,6 +1702,182 @@ inline void dng_lossless_decoder::HuffExtend (int32 &x, int32 s)
 
 /*****************************************************************************/
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FastHuffInit --
+ *
+ *	Build the fast decoding table of a Huffman table, which
+ *	must have been prepared by FixHuffTbl.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	fastHuffBuffer [tableIndex] is filled in.
+ *
+ *--------------------------------------------------------------
+ */
+
+void dng_lossless_decoder::FastHuffInit (int32 tableIndex)
+	{
+	
+	HuffmanTable *htbl = info.dcHuffTblPtrs [tableIndex];
+	
+	const uint32 tableSize = 1 << kFastHuffBits;
+	
+	if (fastHuffBuffer [tableIndex].Buffer () == NULL)
+		{
+		fastHuffBuffer [tableIndex].Allocate (tableSize * (uint32) sizeof (int32));
+		}
+	
+	int32 *fastTable = fastHuffBuffer [tableIndex].Buffer_int32 ();
+	
+	memset (fastTable, 0, tableSize * sizeof (int32));
+	
+	// Generate the codes in code-length order, as in Figure C.2.
+	
+	int32 p = 0;
+	
+	int32 code = 0;
+	
+	for (int32 l = 1; l <= kFastHuffBits; l++)
+		{
+		
+		for (int32 i = 0; i < (int32) htbl->bits [l]; i++, p++, code++)
+			{
+			
+			// Codes of a bad table may overflow, leave them to the
+			// regular path.
+			
+			if (p > 255 || code >= (1 << l))
+				{
+				return;
+				}
+			
+			int32 s = htbl->huffval [p];
+			
+			int32 first = code << (kFastHuffBits - l);
+			int32 last  = first + (1 << (kFastHuffBits - l));
+			
+			for (int32 index = first; index < last; index++)
+				{
+				
+				int32 entry;
+				
+				if (s == 0)
+					{
+					entry = kFastHuffDiff | l;
+					}
+					
+				else if (s == 16 && !fBug16)
+					{
+					entry = (int32) ((uint32) -32768 << 8) | kFastHuffDiff | l;
+					}
+				
+				else if (s < 16 && l + s <= kFastHuffBits)
+					{
+					
+					int32 d = (index >> (kFastHuffBits - l - s)) & ((1 << s) - 1);
+					
+					HuffExtend (d, s);
+					
+					entry = (int32) ((uint32) d << 8) | kFastHuffDiff | (l + s);
+					
+					}
+					
+				else
+					{
+					entry = (s << 8) | l;
+					}
+					
+				fastTable [index] = entry;
+				
+				}
+			
+			}
+		
+		code <<= 1;
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DecodeDiff --
+ *
+ *	Decode the next difference (section F.2.2.1). Codes up to
+ *	kFastHuffBits bits are looked up in the fast table, often
+ *	together with their difference bits.
+ *
+ * Results:
+ *	The difference.
+ *
+ * Side effects:
+ *	Bitstream is parsed.
+ *
+ *--------------------------------------------------------------
+ */
+
+inline int32 dng_lossless_decoder::DecodeDiff (HuffmanTable *htbl,
+											   const int32 *fastTable)
+	{
+	
+	if (bitsLeft < kFastHuffBits)
+		FillBitBuffer (kFastHuffBits);
+		
+	int32 entry = fastTable [(getBuffer >> (bitsLeft - kFastHuffBits)) &
+							 ((1 << kFastHuffBits) - 1)];
+	
+	int32 s;
+	
+	if (entry)
+		{
+		
+		flush_bits (entry & 0x1F);
+		
+		if (entry & kFastHuffDiff)
+			{
+			return entry >> 8;
+			}
+			
+		s = entry >> 8;
+		
+		}
+		
+	else
+		{
+		s = HuffDecode (htbl);
+		}
+		
+	int32 d = 0;
+	
+  	if (s)
+  		{
+  		
+  		if (s == 16 && !fBug16)
+  			{
+  			d = -32768;
+  			}
+  			
+  		else
+  			{
+			d = get_bits (s);
+        	HuffExtend (d, s);
+        	}
+
+        }
+        
+	return d;
+	
+	}
+
+/*****************************************************************************/
+
 // Called from DecodeImage () to write one row.
  
 void dng_lossless_decoder::PmPutRow (MCU *buf,
@@ -1731,25 +1933,7 @@ void dng_lossless_decoder::DecodeFirstRow (MCU *curRowBuf)
 
         // Section F.2.2.1: decode the difference
 
-  		int32 d = 0;
-	
-        int32 s = HuffDecode (dctbl);
-        
-      	if (s)
-      		{
-      		
-      		if (s == 16 && !fBug16)
-      			{
-      			d = -32768;
-      			}
-      		
-      		else
-      			{
-				d = get_bits (s);
-            	HuffExtend (d, s);
-            	}
-
-            }
+        int32 d = DecodeDiff (dctbl, fastHuffBuffer [compptr->dcTblNo].Buffer_int32 ());
 
 		// Add the predictor to the difference.
 
@@ -1778,25 +1962,7 @@ void dng_lossless_decoder::DecodeFirstRow (MCU *curRowBuf)
 
 			// Section F.2.2.1: decode the difference
 
-	  		int32 d = 0;
-		
-	        int32 s = HuffDecode (dctbl);
-	        
-	      	if (s)
-	      		{
-
-	      		if (s == 16 && !fBug16)
-	      			{
-	      			d = -32768;
-	      			}
-	      		
-	      		else
-	      			{
-					d = get_bits (s);
-	            	HuffExtend (d, s);
-	            	}
-
-	            }
+	        int32 d = DecodeDiff (dctbl, fastHuffBuffer [compptr->dcTblNo].Buffer_int32 ());
 	            
 			// Add the predictor to the difference.
 
@@ -1848,6 +2014,8 @@ void dng_lossless_decoder::DecodeImage ()
     
     HuffmanTable *ht [4];
     
+    const int32 *fast [4];
+    
 	for (int32 curComp = 0; curComp < compsInScan; curComp++)
     	{
     	
@@ -1856,6 +2024,8 @@ void dng_lossless_decoder::DecodeImage ()
         JpegComponentInfo *compptr = info.curCompInfo [ci];
         
         ht [curComp] = info.dcHuffTblPtrs [compptr->dcTblNo];
+        
+        fast [curComp] = fastHuffBuffer [compptr->dcTblNo].Buffer_int32 ();
 
    		}
 		
@@ -2369,25 +2539,7 @@ void dng_lossless_decoder::DecodeImage ()
         	
 	        // Section F.2.2.1: decode the difference
 
-	  		int32 d = 0;
-		
-	        int32 s = HuffDecode (ht [curComp]);
-	        
-	      	if (s)
-	      		{
-
-	      		if (s == 16 && !fBug16)
-	      			{
-	      			d = -32768;
-	      			}
-	      		
-	      		else
-	      			{
-					d = get_bits (s);
-	            	HuffExtend (d, s);
-	            	}
-
-	            }
+	        int32 d = DecodeDiff (ht [curComp], fast [curComp]);
 	            
 	        // First column of row above is predictor for first column.
 
@@ -2412,49 +2564,9 @@ void dng_lossless_decoder::DecodeImage ()
 			for (int32 col = 1; col < numCOL; col++)
 	        	{
 	        	
-		        int32 s = HuffDecode (ht [0]);
-		        
-		      	if (s)
-		      		{
-		      		
-		      		int32 d;
-
-		      		if (s == 16 && !fBug16)
-		      			{
-		      			d = -32768;
-		      			}
-		      		
-		      		else
-		      			{
-						d = get_bits (s);
-		            	HuffExtend (d, s);
-		            	}
-
-		        	prev0 += d;
-		        	
-		            }
-		            
-		        s = HuffDecode (ht [1]);
+		        prev0 += DecodeDiff (ht [0], fast [0]);
 		        
-		      	if (s)
-		      		{
-		      		
-		      		int32 d;
-
-		      		if (s == 16 && !fBug16)
-		      			{
-		      			d = -32768;
-		      			}
-		      		
-		      		else
-		      			{
-						d = get_bits (s);
-		            	HuffExtend (d, s);
-		            	}
-
-					prev1 += d;
-					
-		            }
+		        prev1 += DecodeDiff (ht [1], fast [1]);
 		        
 				dPtr [0] = (uint16) prev0;
 				dPtr [1] = (uint16) prev1;
@@ -2476,25 +2588,7 @@ void dng_lossless_decoder::DecodeImage ()
 	            	
 		 	        // Section F.2.2.1: decode the difference
 
-			  		int32 d = 0;
-				
-			        int32 s = HuffDecode (ht [curComp]);
-			        
-			      	if (s)
-			      		{
-			      		
-			      		if (s == 16 && !fBug16)
-			      			{
-			      			d = -32768;
-			      			}
-			      		
-			      		else
-			      			{
-							d = get_bits (s);
-			            	HuffExtend (d, s);
-			            	}
-
-			            }
+			        int32 d = DecodeDiff (ht [curComp], fast [curComp]);
 			            
 			        // Predict the pixel value.
 		            
@@ -2602,6 +2696,8 @@ class dng_lossless_encoder
 		
 		int32 fSrcRowStep;
 		int32 fSrcColStep;
+		
+		uint32 fHuffmanRowStep;
 	
 		dng_stream &fStream;
 	
@@ -2611,8 +2707,13 @@ class dng_lossless_encoder
 		
 		// Current bit-accumulation buffer
 
-		int32 huffPutBuffer;
-		int32 huffPutBits;
+		uint64 huffPutBuffer;
+		uint32 huffPutBits;
+		
+		// Output bytes, collected before they are put to the stream
+		
+		uint8 fOutBuffer [4096];
+		uint32 fOutCount;
 		
 		// Lookup table for number of bits in an 8 bit value.
 		
@@ -2627,6 +2728,7 @@ class dng_lossless_encoder
 					 	      uint32 srcBitDepth,
 					 	      int32 srcRowStep,
 					 	      int32 srcColStep,
+					 	      uint32 huffmanRowStep,
 					 	      dng_stream &stream);
 		
 		void Encode ();
@@ -2635,7 +2737,11 @@ class dng_lossless_encoder
 	
 		void EmitByte (uint8 value);
 	
-		void EmitBits (int code, int size);
+		void FlushOutput ();
+	
+		void EmitBits (uint32 code, uint32 size);
+
+		void EmitWholeBytes ();
 
 		void FlushBits ();
 
@@ -2678,6 +2784,7 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 											uint32 srcBitDepth,
 											int32 srcRowStep,
 											int32 srcColStep,
+											uint32 huffmanRowStep,
 											dng_stream &stream)
 								    
 	:	fSrcData     (srcData    )
@@ -2687,10 +2794,12 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 	,	fSrcBitDepth (srcBitDepth)
 	,	fSrcRowStep  (srcRowStep )
 	,	fSrcColStep  (srcColStep )
+	,	fHuffmanRowStep (huffmanRowStep > 1 ? huffmanRowStep : 1)
 	,	fStream      (stream     )
 	
 	,	huffPutBuffer (0)
 	,	huffPutBits   (0)
+	,	fOutCount     (0)
 	
 	{
 	
@@ -2720,7 +2829,23 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 inline void dng_lossless_encoder::EmitByte (uint8 value)
 	{
 	
-	fStream.Put_uint8 (value);
+	if (fOutCount == sizeof (fOutBuffer))
+		{
+		FlushOutput ();
+		}
+	
+	fOutBuffer [fOutCount++] = value;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_lossless_encoder::FlushOutput ()
+	{
+	
+	fStream.Put (fOutBuffer, fOutCount);
+	
+	fOutCount = 0;
 	
 	}
 	
@@ -2733,11 +2858,10 @@ inline void dng_lossless_encoder::EmitByte (uint8 value)
  *
  *	Code for outputting bits to the file
  *
- *	Only the right 24 bits of huffPutBuffer are used; the valid
- *	bits are left-justified in this part.  At most 16 bits can be
- *	passed to EmitBits in one call, and we never retain more than 7
- *	bits in huffPutBuffer between calls, so 24 bits are
- *	sufficient.
+ *	The valid bits are right-justified in the 64 bit huffPutBuffer.
+ *	At most 32 bits can be passed to EmitBits in one call, and whole
+ *	bytes are output as soon as 32 or more bits are kept, so we never
+ *	retain more than 31 bits between calls and 64 bits are sufficient.
  *
  * Results:
  *	None.
@@ -2748,25 +2872,51 @@ inline void dng_lossless_encoder::EmitByte (uint8 value)
  *--------------------------------------------------------------
  */
  
-inline void dng_lossless_encoder::EmitBits (int code, int size)
+inline void dng_lossless_encoder::EmitBits (uint32 code, uint32 size)
 	{
 	
-    DNG_ASSERT (size != 0, "Bad Huffman table entry");
+    DNG_ASSERT (size != 0 && size <= 32, "Bad Huffman table entry");
 
-    int putBits   = size;
-	int putBuffer = code;
-    
-    putBits += huffPutBits;
-    
-    putBuffer <<= 24 - putBits;
-    putBuffer |= huffPutBuffer;
+    huffPutBuffer = (huffPutBuffer << size) | code;
+    huffPutBits  += size;
 
-    while (putBits >= 8)
+    if (huffPutBits >= 32)
     	{
     	
-		uint8 c = (uint8) (putBuffer >> 16);
+    	EmitWholeBytes ();
+    	
+    	}
+    
+	}
+
+/*****************************************************************************/
+
+/*
+ *--------------------------------------------------------------
+ *
+ * EmitWholeBytes --
+ *
+ *	Output the whole bytes accumulated in huffPutBuffer, with
+ *	byte stuffing.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Less than 8 bits are left in huffPutBuffer.
+ *
+ *--------------------------------------------------------------
+ */
 
-		// Output whole bytes we've accumulated with byte stuffing
+inline void dng_lossless_encoder::EmitWholeBytes ()
+	{
+	
+    while (huffPutBits >= 8)
+    	{
+    	
+    	huffPutBits -= 8;
+    	
+		uint8 c = (uint8) (huffPutBuffer >> huffPutBits);
 
 		EmitByte (c);
 		
@@ -2775,13 +2925,7 @@ inline void dng_lossless_encoder::EmitBits (int code, int size)
 	   	 	EmitByte (0);
 			}
 
-		putBuffer <<= 8;
-		putBits -= 8;
-		
     	}
-
-    huffPutBuffer = putBuffer;
-    huffPutBits   = putBits;
     
 	}
 
@@ -2807,10 +2951,12 @@ inline void dng_lossless_encoder::EmitBits (int code, int size)
 void dng_lossless_encoder::FlushBits ()
 	{
 	
-    // The first call forces output of any partial bytes.
+    // Pad any partial byte with ones and force it out.
 
     EmitBits (0x007F, 7);
     
+    EmitWholeBytes ();
+    
     // We can then zero the buffer.
 
     huffPutBuffer = 0;
@@ -2905,26 +3051,29 @@ inline void dng_lossless_encoder::EncodeOneDiff (int diff, HuffmanTable *dctbl)
     int nbits = temp >= 256 ? numBitsTable [temp >> 8  ] + 8
     						: numBitsTable [temp & 0xFF];
 
-    // Emit the Huffman-coded symbol for the number of bits
-
-    EmitBits (dctbl->ehufco [nbits],
-    		  dctbl->ehufsi [nbits]);
-
-    // Emit that number of bits of the value, if positive,
-    // or the complement of its magnitude, if negative.
+    // Emit the Huffman-coded symbol for the number of bits, followed by
+    // that number of bits of the value, if positive, or the complement
+    // of its magnitude, if negative. Both go out in one call.
     
     // If the number of bits is 16, there is only one possible difference
     // value (-32786), so the lossless JPEG spec says not to output anything
     // in that case.  So we only need to output the diference value if
     // the number of bits is between 1 and 15.
 
+    uint32 code = dctbl->ehufco [nbits];
+    uint32 size = dctbl->ehufsi [nbits];
+
+    DNG_ASSERT (size != 0, "Bad Huffman table entry");
+
     if (nbits & 15)
     	{
     	
-		EmitBits (temp2 & (0x0FFFF >> (16 - nbits)),
-				  nbits);
+		code = (code << nbits) | (temp2 & (0x0FFFF >> (16 - nbits)));
+		size += nbits;
 		
 		}
+		
+    EmitBits (code, size);
 
 	}
 
@@ -2936,6 +3085,7 @@ inline void dng_lossless_encoder::EncodeOneDiff (int diff, HuffmanTable *dctbl)
  * FreqCountSet --
  *
  *      Count the times each category symbol occurs in this image.
+ *	With a row step above one, only every n-th row is counted.
  *
  * Results:
  *	None.
@@ -2952,9 +3102,27 @@ void dng_lossless_encoder::FreqCountSet ()
     
 	memset (freqCount, 0, sizeof (freqCount));
 	
+	// A sample of the rows may miss some categories, which still
+	// need a code in case they occur in the rows not counted.
+	
+	if (fHuffmanRowStep > 1)
+		{
+		
+		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+			{
+			
+			for (uint32 j = 0; j <= 16; j++)
+				{
+				freqCount [channel] [j] = 1;
+				}
+			
+			}
+		
+		}
+	
 	DNG_ASSERT ((int32)fSrcRows >= 0, "dng_lossless_encoder::FreqCountSet: fSrcRpws too large.");
 
-    for (int32 row = 0; row < (int32)fSrcRows; row++)
+    for (int32 row = 0; row < (int32)fSrcRows; row += fHuffmanRowStep)
     	{
     	
 		const uint16 *sPtr = fSrcData + row * fSrcRowStep;
@@ -3733,6 +3901,8 @@ void dng_lossless_encoder::Encode ()
     // Clean up everything.
     
 	WriteFileTrailer ();
+	
+	FlushOutput ();
 
 	}
 
@@ -3745,7 +3915,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream)
+						 dng_stream &stream,
+						 uint32 huffmanRowStep)
 	{
 	
 	dng_lossless_encoder encoder (srcData,
@@ -3755,6 +3926,7 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 							      srcBitDepth,
 							      srcRowStep,
 							      srcColStep,
+							      huffmanRowStep,
 							      stream);
 
 	encoder.Encode ();
@@ -53,6 +53,10 @@ void DecodeLosslessJPEG (dng_stream &stream,
 						   
 /*****************************************************************************/
 
+// The Huffman tables are built from the statistics of every huffmanRowStep-th
+// row. The default of 1 gives optimal tables, larger steps save most of the
+// counting pass for a slightly larger output.
+
 void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcRows,
 						 uint32 srcCols,
@@ -60,7 +64,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream);
+						 dng_stream &stream,
+						 uint32 huffmanRowStep = 1);
 						 
 /*****************************************************************************/
 
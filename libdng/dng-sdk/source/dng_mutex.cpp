@@ -17,6 +17,7 @@
 #include "dng_exceptions.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 /*****************************************************************************/
 
@@ -86,6 +87,52 @@ namespace
 		};
 
 	InnermostMutexHolder gInnermostMutexHolder;
+
+	// Process-wide contention counts, keyed by mutex name. Only touched
+	// on the (already slow) contended path.
+
+	const uint32 kMaxContentionNames = 64;
+
+	struct ContentionTally
+		{
+		const char *fName;
+		uint64 fCount;
+		};
+
+	pthread_mutex_t gContentionMutex = PTHREAD_MUTEX_INITIALIZER;
+
+	ContentionTally gContentionTally [kMaxContentionNames];
+
+	uint32 gContentionNames = 0;
+
+	void TallyContention (const char *mutexName)
+		{
+
+		pthread_mutex_lock (&gContentionMutex);
+
+		uint32 index = 0;
+
+		while (index < gContentionNames &&
+			   strcmp (gContentionTally [index].fName, mutexName) != 0)
+			{
+			index++;
+			}
+
+		if (index == gContentionNames && index < kMaxContentionNames)
+			{
+			gContentionTally [index].fName  = mutexName;
+			gContentionTally [index].fCount = 0;
+			gContentionNames++;
+			}
+
+		if (index < gContentionNames)
+			{
+			gContentionTally [index].fCount++;
+			}
+
+		pthread_mutex_unlock (&gContentionMutex);
+
+		}
 	
 	}
 
@@ -100,6 +147,7 @@ dng_mutex::dng_mutex (const char *mutexName, uint32 mutexLevel)
 	:	fPthreadMutex		()
 	,	fMutexLevel			(mutexLevel)
 	,	fRecursiveLockCount (0)
+	,	fContentionCount	(0)
 	,	fPrevHeldMutex		(NULL)
 	,	fMutexName			(mutexName)
 	
@@ -172,8 +220,27 @@ void dng_mutex::Lock ()
 
 		}
 
+	#if qWinOS
+
+	// dng_pthread has no trylock, so contention isn't counted here.
+
 	pthread_mutex_lock (&fPthreadMutex);
 
+	#else
+
+	if (pthread_mutex_trylock (&fPthreadMutex) != 0)
+		{
+
+		pthread_mutex_lock (&fPthreadMutex);
+
+		fContentionCount++;
+
+		TallyContention (MutexName ());
+
+		}
+
+	#endif
+
 	fPrevHeldMutex = innermostMutex;
 
 	gInnermostMutexHolder.SetInnermostMutex (this);
@@ -228,6 +295,60 @@ const char *dng_mutex::MutexName () const
 
 /*****************************************************************************/
 
+uint64 dng_mutex::ContentionCount () const
+	{
+
+	#if qDNGThreadSafe
+
+	return fContentionCount;
+
+	#else
+
+	return 0;
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
+void dng_mutex::ReportContention (ContentionReporter reporter,
+								  void *context)
+	{
+
+	#if qDNGThreadSafe
+
+	ContentionTally tally [kMaxContentionNames];
+
+	pthread_mutex_lock (&gContentionMutex);
+
+	uint32 names = gContentionNames;
+
+	for (uint32 index = 0; index < names; index++)
+		{
+		tally [index] = gContentionTally [index];
+		}
+
+	pthread_mutex_unlock (&gContentionMutex);
+
+	for (uint32 index = 0; index < names; index++)
+		{
+		reporter (tally [index].fName,
+				  tally [index].fCount,
+				  context);
+		}
+
+	#else
+
+	(void) reporter;
+	(void) context;
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
 dng_lock_mutex::dng_lock_mutex (dng_mutex *mutex)
 
 	:	fMutex (mutex)
@@ -53,6 +53,24 @@ class dng_mutex
 		
 		const char *MutexName () const;
 
+		/// Number of Lock calls that had to wait because another thread
+		/// held this mutex. Always 0 on Windows, where dng_pthread has no
+		/// trylock to detect the wait.
+
+		uint64 ContentionCount () const;
+
+		typedef void (*ContentionReporter) (const char *mutexName,
+											uint64 count,
+											void *context);
+
+		/// Calls reporter once for every mutex name that saw contention, with
+		/// the number of waiting Lock calls summed over all mutexes of that
+		/// name since program start. Useful to find lock hot spots under load.
+		/// Reports nothing on Windows, see ContentionCount.
+
+		static void ReportContention (ContentionReporter reporter,
+									  void *context);
+
 	protected:
 	
 		#if qDNGThreadSafe
@@ -63,6 +81,8 @@ class dng_mutex
 
 		uint32 fRecursiveLockCount;
 
+		uint64 fContentionCount;
+
 		dng_mutex *fPrevHeldMutex;
 
 		const char * const fMutexName;
@@ -2779,3 +2779,38 @@ void RefMapArea16 (uint16 *dPtr,
 	}
 
 /*****************************************************************************/
+
+void RefExtractPlanes16 (const uint16 *sPtr,
+						 uint16 *dPtr,
+						 uint32 count,
+						 uint32 sPlanes,
+						 uint32 dPlanes)
+	{
+	
+	if (sPlanes == dPlanes)
+		{
+		
+		DoCopyBytes (sPtr, dPtr, count * dPlanes * (uint32) sizeof (uint16));
+		
+		return;
+		
+		}
+	
+	for (uint32 index = 0; index < count; index++)
+		{
+		
+		for (uint32 plane = 0; plane < dPlanes; plane++)
+			{
+			
+			dPtr [plane] = sPtr [plane];
+			
+			}
+		
+		sPtr += sPlanes;
+		dPtr += dPlanes;
+		
+		}
+	
+	}
+
+/*****************************************************************************/
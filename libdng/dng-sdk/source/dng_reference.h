@@ -516,6 +516,14 @@ void RefMapArea16 (uint16 *dPtr,
 
 /*****************************************************************************/
 
+void RefExtractPlanes16 (const uint16 *sPtr,
+						 uint16 *dPtr,
+						 uint32 count,
+						 uint32 sPlanes,
+						 uint32 dPlanes);
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
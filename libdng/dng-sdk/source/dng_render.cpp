@@ -1293,12 +1293,9 @@ dng_image * dng_render::Render ()
 											   srcImage->Planes    (),
 											   srcImage->PixelType ()));
 											 
-		ResampleImage (fHost,
-					   *srcImage,
-					   *tempImage.Get (),
-					   srcBounds,
-					   tempImage->Bounds (),
-					   dng_resample_bicubic::Get ());
+		ResampleStage3 (*srcImage,
+						*tempImage.Get (),
+						srcBounds);
 						   
 		srcImage = tempImage.Get ();
 		
@@ -1312,16 +1309,45 @@ dng_image * dng_render::Render ()
 													   dstPlanes,
 													   FinalPixelType ()));
 													 
-	dng_render_task task (*srcImage,
-						  *dstImage.Get (),
+	RenderPixels (*srcImage,
+				  *dstImage.Get (),
+				  srcBounds.TL ());
+						  
+	return dstImage.Release ();
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render::ResampleStage3 (const dng_image &srcImage,
+								 dng_image &dstImage,
+								 const dng_rect &srcBounds)
+	{
+	
+	ResampleImage (fHost,
+				   srcImage,
+				   dstImage,
+				   srcBounds,
+				   dstImage.Bounds (),
+				   dng_resample_bicubic::Get ());
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render::RenderPixels (const dng_image &srcImage,
+							   dng_image &dstImage,
+							   const dng_point &srcOffset)
+	{
+	
+	dng_render_task task (srcImage,
+						  dstImage,
 						  fNegative,
 						  *this,
-						  srcBounds.TL ());
+						  srcOffset);
 						  
 	fHost.PerformAreaTask (task,
-						   dstImage->Bounds ());
-						  
-	return dstImage.Release ();
+						   dstImage.Bounds ());
 	
 	}
 
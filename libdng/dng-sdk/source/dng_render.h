@@ -295,6 +295,29 @@ class dng_render
 
 		virtual dng_image * Render ();
 									
+	protected:
+	
+		/// Resample the stage 3 image to the size of the final image. The default
+		/// uses a bicubic filter; subclasses may trade accuracy for speed.
+		/// \param srcImage Stage 3 image.
+		/// \param dstImage Image of the final size to resample into.
+		/// \param srcBounds Area of srcImage to resample.
+
+		virtual void ResampleStage3 (const dng_image &srcImage,
+									 dng_image &dstImage,
+									 const dng_rect &srcBounds);
+	
+		/// Render stage 3 pixels, already of the final size, to the final color
+		/// space. The default runs the exact color pipeline; subclasses may use
+		/// an approximation of it.
+		/// \param srcImage Stage 3 pixels.
+		/// \param dstImage Image to render into.
+		/// \param srcOffset Position in srcImage of the top left pixel of dstImage.
+
+		virtual void RenderPixels (const dng_image &srcImage,
+								   dng_image &dstImage,
+								   const dng_point &srcOffset);
+	
 	private:
 	
 		// Hidden copy constructor and assignment operator.
@@ -26,73 +26,156 @@
 #include "dng_area_task.h"
 #include "dng_rect.h"
 
+#include "dng_sdk_limits.h"
+#include "dng_utils.h"
+#include "threadpool.h"
+#include "simdsuite.h"
+#include "cowimage.h"
+
+#include <thread>
+
 #ifndef kLocalUseThreads
 #define kLocalUseThreads 1
 #endif
 
+
+DngHost::DngHost(dng_memory_allocator *allocator, dng_abort_sniffer *sniffer) :
+    dng_host(allocator, sniffer),
+    m_threadCount(DefaultThreadCount()),
+#if kLocalUseThreads
+    m_threadPool(&ThreadPool::Shared())
+#else
+    m_threadPool(NULL)
+#endif
+{
+    InstallSimdSuite();
+}
+
+
+void DngHost::SetThreadCount(uint32 threadCount) {
+    m_threadCount = Pin_uint32(1, (threadCount == 0) ? DefaultThreadCount() : threadCount, kMaxMPThreads);
+}
+
+
+uint32 DngHost::DefaultThreadCount() {
+    return Pin_uint32(1, std::thread::hardware_concurrency(), kMaxMPThreads);
+}
+
+
+dng_image* DngHost::Make_dng_image(const dng_rect &bounds, uint32 planes, uint32 pixelType) {
+    return new CowImage(bounds, planes, pixelType, Allocator());
+}
+
+
 #if !kLocalUseThreads
 
 void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area) { 
    dng_area_task::Perform(task, area, &Allocator (), Sniffer ());
 }
 
+uint32 DngHost::PerformAreaTaskThreads() {return 1;}
+
 #else 
 
-#include <thread>
 #include <vector>
 #include <exception>
-#include "dng_sdk_limits.h"
+#include <atomic>
+#include <mutex>
+#include "dng_exceptions.h"
+#include "dng_tile_iterator.h"
+
+// Abort sniffer of a single area task. Keeps the first exception thrown by any of the task's
+// tiles and cancels the remaining tiles from then on; otherwise defers to the host's sniffer.
+// Every PerformAreaTask-call has its own, so concurrent tasks don't see each other's errors.
+class AreaTaskSniffer : public dng_abort_sniffer {
+public:
+    AreaTaskSniffer(dng_abort_sniffer *hostSniffer) : m_hostSniffer(hostSniffer), m_failed(false) {
+        if (hostSniffer != NULL) SetPriority(hostSniffer->Priority());
+    }
 
-static std::exception_ptr threadException = nullptr;
+    void Fail(std::exception_ptr exception) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_exception) m_exception = exception;
+        m_failed = true;
+    }
 
-static void executeAreaThread(std::reference_wrapper<dng_area_task> task, uint32 threadIndex, const dng_rect &threadArea, const dng_point &tileSize, dng_abort_sniffer *sniffer) {
-   try { task.get().ProcessOnThread(threadIndex, threadArea, tileSize, sniffer); }
-   catch (...) { threadException = std::current_exception(); }
-}
+    bool Failed() const {return m_failed;}
 
+    void RethrowIfFailed() {
+        if (m_failed) std::rethrow_exception(m_exception);
+    }
 
-void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area) {
-    dng_point tileSize(task.FindTileSize(area));
+    virtual bool ThreadSafe() const {return true;}
 
-    // Now we need to do some resource allocation
-    // We start by assuming one tile per thread, and work our way up
-    uint32 vTilesinArea = area.H() / tileSize.v; if ((area.H() - (vTilesinArea * tileSize.v)) > 0) vTilesinArea++;
-    uint32 hTilesinArea = area.W() / tileSize.h; if ((area.W() - (hTilesinArea * tileSize.h)) > 0) hTilesinArea++;
-
-    int vTilesPerThread = 1, hTilesPerThread = 1;
-    // Ensure we don't exceed maxThreads for this task
-    while (((vTilesinArea + vTilesPerThread - 1) / vTilesPerThread) * ((hTilesinArea + hTilesPerThread - 1) / hTilesPerThread) > kMaxMPThreads) {
-        // Here we want to increase the number of tiles per thread; so do we do that in the V or H dimension?
-        if ((vTilesinArea / vTilesPerThread) > (hTilesinArea / hTilesPerThread)) vTilesPerThread++;
-        else hTilesPerThread++;
+protected:
+    virtual void Sniff() {
+        if (m_failed) ThrowUserCanceled();
+        if (m_hostSniffer != NULL) m_hostSniffer->SniffNoPriorityWait();
     }
 
-    task.Start(Min_uint32(task.MaxThreads (), kMaxMPThreads), tileSize, &Allocator (), Sniffer ());
-
-    std::vector<std::thread> areaThreads;
-    threadException = nullptr;
+private:
+    dng_abort_sniffer *m_hostSniffer;
+    std::atomic<bool> m_failed;
+    std::mutex m_mutex;
+    std::exception_ptr m_exception;
+};
+
+// Same tiling as dng_area_task::ProcessOnThread, but collected up-front so that single
+// tiles can be handed out (and stolen) by the thread pool
+static void collectTiles(const dng_area_task &task, const dng_rect &area, const dng_point &tileSize, std::vector<dng_rect> &tiles) {
+    dng_rect repeatingTile1 = task.RepeatingTile1();
+    dng_rect repeatingTile2 = task.RepeatingTile2();
+    dng_rect repeatingTile3 = task.RepeatingTile3();
+    if (repeatingTile1.IsEmpty()) repeatingTile1 = area;
+    if (repeatingTile2.IsEmpty()) repeatingTile2 = area;
+    if (repeatingTile3.IsEmpty()) repeatingTile3 = area;
+
+    dng_rect tile1, tile2, tile3, tile4;
+    dng_tile_iterator iter1(repeatingTile3, area);
+    while (iter1.GetOneTile(tile1)) {
+        dng_tile_iterator iter2(repeatingTile2, tile1);
+        while (iter2.GetOneTile(tile2)) {
+            dng_tile_iterator iter3(repeatingTile1, tile2);
+            while (iter3.GetOneTile(tile3)) {
+                dng_tile_iterator iter4(tileSize, tile3);
+                while (iter4.GetOneTile(tile4)) tiles.push_back(tile4);
+            }
+        }
+    }
+}
 
-    dng_rect threadArea(area.t, area.l, area.t + (vTilesPerThread * tileSize.v), area.l + (hTilesPerThread * tileSize.h));
-    for (uint32 vIndex = 0; vIndex < vTilesinArea; vIndex += vTilesPerThread) {
 
-        for (uint32 hIndex = 0; hIndex < hTilesinArea; hIndex += hTilesPerThread) {
-            try { areaThreads.push_back(std::thread(executeAreaThread, std::ref(task), areaThreads.size(), threadArea, tileSize, Sniffer ())); }
-            catch (...) { executeAreaThread(task, areaThreads.size(), threadArea, tileSize, Sniffer ()); }
+uint32 DngHost::PerformAreaTaskThreads() {return m_threadCount;}
 
-            threadArea.l = threadArea.r;
-            threadArea.r = Min_int32(threadArea.r + (hTilesPerThread * tileSize.h), area.r);
-        }
 
-        threadArea.t = threadArea.b;
-        threadArea.l = area.l;
-        threadArea.b = Min_int32(threadArea.b + (vTilesPerThread * tileSize.v), area.b);
-        threadArea.r = area.l + (hTilesPerThread * tileSize.h);
+void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area) {
+    uint32 maxThreads = Min_uint32(task.MaxThreads(), m_threadCount);
+    if (maxThreads <= 1 || m_threadPool == NULL) {
+        dng_area_task::Perform(task, area, &Allocator (), Sniffer ());
+        return;
     }
 
-   for (auto& areaThread : areaThreads) areaThread.join();
-   if (threadException) std::rethrow_exception(threadException);
+    dng_point tileSize(task.FindTileSize(area));
+
+    std::vector<dng_rect> tiles;
+    collectTiles(task, area, tileSize, tiles);
+    uint32 threadCount = Min_uint32(maxThreads, static_cast<uint32>(tiles.size()));
+
+    AreaTaskSniffer sniffer(Sniffer ());
+    task.Start(threadCount, tileSize, &Allocator (), &sniffer);
+
+    m_threadPool->Run(threadCount, static_cast<uint32>(tiles.size()), [&](uint32 threadIndex, uint32 tileIndex) {
+        if (sniffer.Failed()) return;  // skip the remaining tiles once one has failed
+        try {
+            dng_abort_sniffer::SniffForAbort(&sniffer);
+            task.Process(threadIndex, tiles[tileIndex], &sniffer);
+        }
+        catch (...) { sniffer.Fail(std::current_exception()); }
+    });
+
+    sniffer.RethrowIfFailed();
 
-   task.Finish(Min_uint32(task.MaxThreads(), kMaxMPThreads));
+    task.Finish(threadCount);
 }
 
 #endif
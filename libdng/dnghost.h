@@ -21,11 +21,30 @@
 
 #include "dng_host.h"
 
+class ThreadPool;
+
 class DngHost : public dng_host {
 public:
-    DngHost(dng_memory_allocator *allocator = NULL, dng_abort_sniffer *sniffer = NULL) {}
+    DngHost(dng_memory_allocator *allocator = NULL, dng_abort_sniffer *sniffer = NULL);
     ~DngHost(void) {}
 
+    // Number of threads used for area tasks (tile processing, encoding and decoding)
+    // 0 selects the default (hardware concurrency), the count is always capped at kMaxMPThreads
+    void SetThreadCount(uint32 threadCount);
+    static uint32 DefaultThreadCount();
+
+    // Pool that runs the area tasks - defaults to the process-wide shared pool, so that
+    // worker threads are created once and reused by every task and every host
+    void SetThreadPool(ThreadPool *threadPool) {m_threadPool = threadPool;}
+
 public:
+    // Images are CowImages, so that cloning (e.g. stage 1 for the raw image) doesn't copy pixels
+    virtual dng_image* Make_dng_image(const dng_rect &bounds, uint32 planes, uint32 pixelType);
+
     virtual void PerformAreaTask(dng_area_task &task, const dng_rect &area);
+    virtual uint32 PerformAreaTaskThreads();
+
+private:
+    uint32 m_threadCount;
+    ThreadPool *m_threadPool;
 };
@@ -0,0 +1,43 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "dngimagewriter.h"
+
+#include "dng_host.h"
+#include "dng_ifd.h"
+
+
+uint32 DngImageWriter::AutomaticTileSize(uint32 imageWidth, uint32 imageLength, uint32 threadCount) {
+    uint32 tileSize = kMaxTileSize;
+    while (tileSize > kMinTileSize) {
+        uint64 tileCount = static_cast<uint64>((imageWidth + tileSize - 1) / tileSize) * ((imageLength + tileSize - 1) / tileSize);
+        if (tileCount >= static_cast<uint64>(kTilesPerThread) * threadCount) break;
+        tileSize /= 2;
+    }
+    return tileSize;
+}
+
+
+void DngImageWriter::FindRawJPEGTileSize(dng_host &host, dng_ifd &ifd) {
+    uint32 tileSize = (m_rawTileSize != 0) ? m_rawTileSize :
+                      AutomaticTileSize(ifd.fImageWidth, ifd.fImageLength, host.PerformAreaTaskThreads());
+
+    // let the SDK spread the tiles evenly over the image, with about tileSize x tileSize samples each
+    uint32 bytesPerSample = ifd.fSamplesPerPixel * ((ifd.fBitsPerSample[0] + 7) >> 3);
+    ifd.FindTileSize(tileSize * tileSize * bytesPerSample);
+}
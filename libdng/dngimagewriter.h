@@ -0,0 +1,57 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_image_writer.h"
+
+/*
+  dng_image_writer with a tile size policy for the lossless JPEG compressed raw image.
+
+  Larger tiles compress a bit better, as each tile restarts the predictors and carries its
+  own headers and Huffman tables. But the tiles are also what the writer's threads share out
+  (and they are written in order), so there must be enough of them for every thread to stay
+  busy. Unless a fixed size is set, the largest tiles that still give every thread a few of
+  them are used - e.g. 1024 pixels single-threaded, 512 with 8 threads on a 6000x4000 frame.
+
+  In fast mode, the Huffman tables of each tile are built from every 16th row only. That
+  saves most of the frequency counting pass, which otherwise reads the whole tile once more
+  before it is encoded, for files that are slightly larger.
+*/
+class DngImageWriter : public dng_image_writer {
+public:
+    // rawTileSize is the edge length of the raw image's tiles in pixels (16 to 16384), 0 picks one automatically
+    explicit DngImageWriter(uint32 rawTileSize = 0, bool fastCompression = false) :
+        m_rawTileSize(rawTileSize), m_fastCompression(fastCompression) {}
+
+    // Edge length the automatic policy picks for an image of this size written by threadCount threads
+    static uint32 AutomaticTileSize(uint32 imageWidth, uint32 imageLength, uint32 threadCount);
+
+    static const uint32 kMinTileSize = 256;   // SDK default for 16-bit raw data
+    static const uint32 kMaxTileSize = 1024;
+    static const uint32 kTilesPerThread = 4;
+    static const uint32 kFastHuffmanRowStep = 16;
+
+protected:
+    virtual void FindRawJPEGTileSize(dng_host &host, dng_ifd &ifd);
+    virtual uint32 LosslessJPEGHuffmanRowStep() const {return m_fastCompression ? kFastHuffmanRowStep : 1;}
+
+private:
+    uint32 m_rawTileSize;
+    bool m_fastCompression;
+};
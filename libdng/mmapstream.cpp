@@ -0,0 +1,171 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "mmapstream.h"
+
+#include "dng_exceptions.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+const uint64 kMinReservation = 16 * 1024 * 1024;
+
+
+MappedFile::MappedFile(const char *filename) : m_data(NULL), m_size(0), m_mapped(false) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) ThrowOpenFile();
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        ThrowReadFile();
+    }
+    m_size = static_cast<uint64>(status.st_size);
+    if (m_size == 0) {
+        close(fd);
+        return;
+    }
+
+    void *mapping = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+        // the file is parsed start to end a few times, so prefetch all of it
+        posix_madvise(mapping, m_size, POSIX_MADV_WILLNEED);
+        m_data = static_cast<const uint8*>(mapping);
+        m_mapped = true;
+        close(fd);
+        return;
+    }
+
+    // Not mappable (not supported by all filesystems) - read it instead
+    uint8 *buffer = static_cast<uint8*>(std::malloc(m_size));
+    if (buffer == NULL) {
+        close(fd);
+        ThrowMemoryFull();
+    }
+    uint64 done = 0;
+    while (done < m_size) {
+        ssize_t count = read(fd, buffer + done, m_size - done);
+        if (count <= 0) {
+            std::free(buffer);
+            close(fd);
+            ThrowReadFile();
+        }
+        done += count;
+    }
+    close(fd);
+    m_data = buffer;
+}
+
+
+MappedFile::~MappedFile() {
+    if (m_mapped) munmap(const_cast<uint8*>(m_data), m_size);
+    else std::free(const_cast<uint8*>(m_data));
+}
+
+
+MmapStream::MmapStream(const char *filename) :
+    MappedFile(filename),
+    dng_stream(MappedData(), static_cast<uint32>(MappedSize()), 0)
+{
+    // Stream positions are 64 bit, but the buffer size isn't - and no TIFF based format gets this large
+    if (MappedSize() > 0xFFFFFFFF) ThrowReadFile();
+}
+
+
+PwriteStream::PwriteStream(const char *filename, uint32 bufferSize) :
+    dng_stream((dng_abort_sniffer*) NULL, bufferSize, 0),
+    m_file(-1), m_length(0), m_reserved(0)
+{
+    m_file = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (m_file < 0) ThrowOpenFile();
+}
+
+
+PwriteStream::~PwriteStream() {
+    if (m_file < 0) return;
+
+    // Best effort, Close() wasn't called (or failed) so there's nothing to report to
+    if (m_reserved != 0) {
+        if (ftruncate(m_file, m_length) != 0) {}
+    }
+    close(m_file);
+}
+
+
+void PwriteStream::Close() {
+    if (m_file < 0) return;
+
+    // Cut off the reserved space that wasn't used
+    bool failed = (m_reserved != 0) && (ftruncate(m_file, m_length) != 0);
+    if (close(m_file) != 0) failed = true;
+    m_file = -1;
+
+    if (failed) ThrowWriteFile();
+}
+
+
+uint64 PwriteStream::DoGetLength() {
+    // Not the file size, which includes the reservation
+    return m_length;
+}
+
+
+void PwriteStream::DoRead(void *data, uint32 count, uint64 offset) {
+    uint8 *buffer = static_cast<uint8*>(data);
+    while (count > 0) {
+        ssize_t done = pread(m_file, buffer, count, offset);
+        if (done <= 0) ThrowReadFile();
+        buffer += done;
+        count -= static_cast<uint32>(done);
+        offset += done;
+    }
+}
+
+
+void PwriteStream::DoSetLength(uint64 length) {
+    if (ftruncate(m_file, length) != 0) ThrowWriteFile();
+    m_length = length;
+    if (m_reserved != ~static_cast<uint64>(0)) m_reserved = length;
+}
+
+
+void PwriteStream::DoWrite(const void *data, uint32 count, uint64 offset) {
+    // Best effort only: filesystems without fallocate fail it (unlike posix_fallocate, which would
+    // write zeros instead), and the file simply grows with the writes then
+    if (offset + count > m_reserved) {
+        uint64 reservation = std::max(std::max(offset + count, m_reserved * 2), kMinReservation);
+        if (fallocate(m_file, 0, 0, reservation) == 0) m_reserved = reservation;
+        else m_reserved = ~static_cast<uint64>(0);
+    }
+
+    const uint8 *buffer = static_cast<const uint8*>(data);
+    while (count > 0) {
+        ssize_t done = pwrite(m_file, buffer, count, offset);
+        if (done <= 0) ThrowWriteFile();
+        buffer += done;
+        count -= static_cast<uint32>(done);
+        offset += done;
+    }
+    m_length = std::max(m_length, offset);
+}
@@ -0,0 +1,98 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_stream.h"
+
+/*
+  Read-only mapping of a whole file. Where a file can't be mapped, it is read into memory.
+*/
+class MappedFile {
+public:
+    // Throws dng_exception (dng_error_open_file / dng_error_read_file) if the file can't be read
+    explicit MappedFile(const char *filename);
+    ~MappedFile();
+
+    const uint8* MappedData() const {return m_data;}
+    uint64 MappedSize() const {return m_size;}
+
+private:
+    const uint8 *m_data;
+    uint64 m_size;
+    bool m_mapped;      // otherwise m_data was allocated with malloc
+
+    // Hidden copy constructor and assignment operator
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+
+/*
+  Read-only dng_stream over a memory-mapped file.
+
+  The mapping is the stream's buffer, so reads are served straight from it without any
+  intermediate copy (and without ever calling DoRead). Data() gives direct access to the
+  contents, so the same mapping can be handed to other parsers (LibRaw, Exiv2) while the
+  DNG SDK reads it through the stream interface.
+*/
+class MmapStream : private MappedFile, public dng_stream {
+public:
+    explicit MmapStream(const char *filename);
+
+    // Whole file contents, valid for the lifetime of the stream
+    const uint8* Data() const {return MappedData();}
+    uint64 Size() const {return MappedSize();}
+};
+
+
+/*
+  Output file stream for large files, e.g. DNGs written by dng_image_writer.
+
+  Writes are collected in a big buffer and written with pwrite, so the many small Put calls
+  for tags and tiles turn into few large writes. The file is pre-sized in growing steps
+  ahead of the data (keeping it contiguous) and cut to its real length by Close(). Like with
+  dng_file_stream, Flush() must be called before that.
+*/
+class PwriteStream : public dng_stream {
+public:
+    // Creates or truncates filename, throws dng_exception (dng_error_open_file) on failure
+    explicit PwriteStream(const char *filename, uint32 bufferSize = kOutputBufferSize);
+    virtual ~PwriteStream();
+
+    // Cuts the file to the written length and closes it, throws dng_exception
+    // (dng_error_write_file) on failure. The destructor does the same but can't report errors.
+    void Close();
+
+    static const uint32 kOutputBufferSize = 1024 * 1024;
+
+protected:
+    virtual uint64 DoGetLength();
+    virtual void DoRead(void *data, uint32 count, uint64 offset);
+    virtual void DoSetLength(uint64 length);
+    virtual void DoWrite(const void *data, uint32 count, uint64 offset);
+
+private:
+    int m_file;
+    uint64 m_length;    // end of the data written so far; the file itself is pre-sized beyond it
+    uint64 m_reserved;  // size the file was pre-sized to, all ones if that isn't supported
+
+    // Hidden copy constructor and assignment operator
+    PwriteStream(const PwriteStream&);
+    PwriteStream& operator=(const PwriteStream&);
+};
@@ -0,0 +1,241 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "poolallocator.h"
+
+#include "dng_exceptions.h"
+
+#include <cstdlib>
+
+
+const uint32 kNoClass = 0xFFFFFFFF;
+
+
+class PoolAllocator::Block : public dng_memory_block {
+public:
+    Block(PoolAllocator &owner, void *memory, uint32 sizeClass, uint32 logicalSize) :
+        dng_memory_block(logicalSize), m_owner(owner), m_memory(memory), m_sizeClass(sizeClass)
+    {
+        SetBuffer(memory);
+    }
+
+    virtual ~Block() {m_owner.Release(m_memory, m_sizeClass, LogicalSize());}
+
+private:
+    PoolAllocator &m_owner;
+    void *m_memory;
+    uint32 m_sizeClass;
+};
+
+
+// Free lists of the small size classes, private to one thread. A thread's cache is only used
+// for the first allocator that thread releases small blocks to; others use their shared lists.
+struct PoolAllocator::ThreadCache {
+    ThreadCache() : owner(NULL), bytes(0) {}
+    ~ThreadCache() {if (owner != NULL) owner->FlushThreadCache(*this);}
+
+    PoolAllocator *owner;
+    std::vector<void*> blocks[kThreadClassCount];
+    uint64 bytes;
+};
+
+thread_local PoolAllocator::ThreadCache PoolAllocator::m_threadCache;
+
+
+PoolAllocator::PoolAllocator(uint64 cacheLimit) :
+    m_cacheLimit(cacheLimit), m_sharedCachedBytes(0),
+    m_liveBytes(0), m_peakLiveBytes(0), m_threadCachedBytes(0), m_hits(0), m_misses(0) {}
+
+
+PoolAllocator::~PoolAllocator() {
+    if (m_threadCache.owner == this) FlushThreadCache(m_threadCache);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TrimLocked(0);
+}
+
+
+PoolAllocator& PoolAllocator::Shared() {
+    // deliberately never destroyed: worker threads may still release their caches during exit
+    static PoolAllocator *sharedAllocator = new PoolAllocator();
+    return *sharedAllocator;
+}
+
+
+// Four classes per power of two, starting with 1 KiB: 1024, 1280, 1536, 1792, 2048, 2560, ...
+uint32 PoolAllocator::SizeClass(uint64 size) {
+    if (size <= 1024) return 0;
+
+    uint32 exponent = 63 - __builtin_clzll(size - 1);  // floor(log2(size - 1)) >= 10
+    uint64 step = static_cast<uint64>(1) << (exponent - 2);
+    uint64 rounded = (size + step - 1) & ~(step - 1);
+
+    exponent = 63 - __builtin_clzll(rounded);
+    uint32 sizeClass = (exponent - 10) * 4 + static_cast<uint32>((rounded >> (exponent - 2)) & 3);
+    return (sizeClass < kClassCount) ? sizeClass : kNoClass;
+}
+
+
+uint64 PoolAllocator::ClassSize(uint32 sizeClass) {
+    return static_cast<uint64>(4 + sizeClass % 4) << (10 + sizeClass / 4 - 2);
+}
+
+
+dng_memory_block* PoolAllocator::Allocate(uint32 size) {
+    // same slack for alignment as dng_memory_block::PhysicalSize
+    uint64 physicalSize = static_cast<uint64>(size) + 64;
+    uint32 sizeClass = SizeClass(physicalSize);
+
+    void *memory = NULL;
+    if (sizeClass < kThreadClassCount && (m_threadCache.owner == this)) {
+        std::vector<void*> &blocks = m_threadCache.blocks[sizeClass];
+        if (!blocks.empty()) {
+            memory = blocks.back();
+            blocks.pop_back();
+            m_threadCache.bytes -= ClassSize(sizeClass);
+            m_threadCachedBytes -= ClassSize(sizeClass);
+        }
+    }
+    if ((memory == NULL) && (sizeClass != kNoClass)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<void*> &blocks = m_freeLists[sizeClass];
+        if (!blocks.empty()) {
+            memory = blocks.back();
+            blocks.pop_back();
+            m_sharedCachedBytes -= ClassSize(sizeClass);
+        }
+    }
+
+    if (memory != NULL) m_hits++;
+    else {
+        m_misses++;
+        memory = std::malloc((sizeClass != kNoClass) ? ClassSize(sizeClass) : physicalSize);
+        if (memory == NULL) ThrowMemoryFull();
+    }
+
+    Block *block = NULL;
+    try {block = new Block(*this, memory, sizeClass, size);}
+    catch (...) {
+        std::free(memory);
+        ThrowMemoryFull();
+    }
+
+    uint64 liveBytes = (m_liveBytes += size);
+    uint64 peakLiveBytes = m_peakLiveBytes;
+    while ((liveBytes > peakLiveBytes) && !m_peakLiveBytes.compare_exchange_weak(peakLiveBytes, liveBytes)) {}
+
+    return block;
+}
+
+
+void PoolAllocator::Release(void *memory, uint32 sizeClass, uint32 logicalSize) {
+    m_liveBytes -= logicalSize;
+
+    if (sizeClass == kNoClass) {
+        std::free(memory);
+        return;
+    }
+
+    uint64 classSize = ClassSize(sizeClass);
+    if (sizeClass < kThreadClassCount) {
+        if (m_threadCache.owner == NULL) m_threadCache.owner = this;
+        std::vector<void*> &blocks = m_threadCache.blocks[sizeClass];
+        if ((m_threadCache.owner == this) && (blocks.size() < kThreadClassDepth) &&
+            (m_threadCache.bytes + classSize <= kThreadCacheLimit)) {
+            blocks.push_back(memory);
+            m_threadCache.bytes += classSize;
+            m_threadCachedBytes += classSize;
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_sharedCachedBytes + classSize <= m_cacheLimit) {
+        m_freeLists[sizeClass].push_back(memory);
+        m_sharedCachedBytes += classSize;
+    }
+    else std::free(memory);
+}
+
+
+void PoolAllocator::FlushThreadCache(ThreadCache &cache) {
+    // hand the blocks over to the shared lists, they are most likely needed again by another thread
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32 sizeClass = 0; sizeClass < kThreadClassCount; sizeClass++) {
+        uint64 classSize = ClassSize(sizeClass);
+        for (auto memory : cache.blocks[sizeClass]) {
+            m_threadCachedBytes -= classSize;
+            if (m_sharedCachedBytes + classSize <= m_cacheLimit) {
+                m_freeLists[sizeClass].push_back(memory);
+                m_sharedCachedBytes += classSize;
+            }
+            else std::free(memory);
+        }
+        cache.blocks[sizeClass].clear();
+    }
+    cache.bytes = 0;
+    cache.owner = NULL;
+}
+
+
+void PoolAllocator::TrimLocked(uint64 cacheLimit) {
+    // free the largest blocks first, small ones are the cheapest to keep
+    for (uint32 sizeClass = kClassCount; (sizeClass-- > 0) && (m_sharedCachedBytes > cacheLimit); ) {
+        std::vector<void*> &blocks = m_freeLists[sizeClass];
+        while (!blocks.empty() && (m_sharedCachedBytes > cacheLimit)) {
+            std::free(blocks.back());
+            blocks.pop_back();
+            m_sharedCachedBytes -= ClassSize(sizeClass);
+        }
+    }
+}
+
+
+void PoolAllocator::SetCacheLimit(uint64 cacheLimit) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheLimit = cacheLimit;
+    TrimLocked(cacheLimit);
+}
+
+
+void PoolAllocator::Trim() {
+    if (m_threadCache.owner == this) {
+        for (uint32 sizeClass = 0; sizeClass < kThreadClassCount; sizeClass++) {
+            for (auto memory : m_threadCache.blocks[sizeClass]) std::free(memory);
+            m_threadCachedBytes -= ClassSize(sizeClass) * m_threadCache.blocks[sizeClass].size();
+            m_threadCache.blocks[sizeClass].clear();
+        }
+        m_threadCache.bytes = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TrimLocked(0);
+}
+
+
+PoolAllocator::Statistics PoolAllocator::GetStatistics() const {
+    Statistics statistics;
+    statistics.liveBytes = m_liveBytes;
+    statistics.peakLiveBytes = m_peakLiveBytes;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    statistics.cachedBytes = m_sharedCachedBytes + m_threadCachedBytes;
+    return statistics;
+}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_memory.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+/*
+  dng_memory_allocator that keeps freed blocks for reuse instead of returning them to malloc.
+
+  Requests are rounded up to size classes (four per power of two, so at most 25% is wasted)
+  and freed blocks go onto a free list of their class. Small blocks - mostly tile buffers of
+  area tasks - are first kept in a cache of the freeing thread, which needs no locking; larger
+  ones, like full stage images, go to lists shared by all threads. The amount of memory kept
+  on the shared lists is capped by the cache limit, anything beyond is freed right away.
+
+  All blocks must be destroyed before the allocator, and threads that used the allocator must
+  exit before it is destroyed (or never use it again). The shared instance is never destroyed.
+*/
+class PoolAllocator : public dng_memory_allocator {
+public:
+    struct Statistics {
+        uint64 liveBytes;       // requested size of all blocks currently handed out
+        uint64 peakLiveBytes;   // maximum of liveBytes so far
+        uint64 cachedBytes;     // memory kept on free lists for reuse
+        uint64 hits;            // allocations served from a free list
+        uint64 misses;          // allocations that had to go to malloc
+    };
+
+    explicit PoolAllocator(uint64 cacheLimit = kDefaultCacheLimit);
+    virtual ~PoolAllocator();
+
+    virtual dng_memory_block* Allocate(uint32 size);
+
+    // Changes the maximum memory kept on the shared free lists, trims if necessary
+    void SetCacheLimit(uint64 cacheLimit);
+
+    // Frees all cached blocks on the shared lists and in the calling thread's cache
+    void Trim();
+
+    Statistics GetStatistics() const;
+
+    // Process-wide allocator, created on first use
+    static PoolAllocator& Shared();
+
+    static const uint64 kDefaultCacheLimit = 512 * 1024 * 1024;
+
+private:
+    class Block;
+    struct ThreadCache;
+
+    static const uint32 kClassCount = 88;       // 1 KiB up to 3.5 GiB
+    static const uint32 kThreadClassCount = 33; // up to 256 KiB
+    static const uint32 kThreadClassDepth = 8;
+    static const uint64 kThreadCacheLimit = 4 * 1024 * 1024;
+
+    static uint32 SizeClass(uint64 size);
+    static uint64 ClassSize(uint32 sizeClass);
+
+    void Release(void *memory, uint32 sizeClass, uint32 logicalSize);
+    void FlushThreadCache(ThreadCache &cache);
+    void TrimLocked(uint64 cacheLimit);
+
+    static thread_local ThreadCache m_threadCache;
+
+    mutable std::mutex m_mutex;
+    std::vector<void*> m_freeLists[kClassCount];  // guarded by m_mutex
+    uint64 m_cacheLimit;                          // guarded by m_mutex
+    uint64 m_sharedCachedBytes;                   // guarded by m_mutex
+
+    std::atomic<uint64> m_liveBytes, m_peakLiveBytes, m_threadCachedBytes, m_hits, m_misses;
+
+    // Hidden copy constructor and assignment operator
+    PoolAllocator(const PoolAllocator&);
+    PoolAllocator& operator=(const PoolAllocator&);
+};
@@ -0,0 +1,333 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "pyramidrender.h"
+#include "renderlut.h"
+
+#include "dng_host.h"
+#include "dng_image.h"
+#include "dng_negative.h"
+#include "dng_camera_profile.h"
+#include "dng_pixel_buffer.h"
+#include "dng_area_task.h"
+#include "dng_resample.h"
+#include "dng_sdk_limits.h"
+#include "dng_memory.h"
+#include "dng_exceptions.h"
+#include "dng_tag_types.h"
+#include "dng_utils.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// Block sizes of the pre-filter in ResampleStage3
+const uint32 kMinBlockSize = 3;
+const uint32 kMaxBlockSize = 16;
+
+
+// Source pixels covered by each destination pixel along one axis, with the covered fraction
+// of each, normalised so that every destination pixel's weights add up to 1
+struct BoxFilter {
+    BoxFilter(uint32 srcSize, uint32 dstSize);
+
+    std::vector<uint32> first;      // first covered source pixel
+    std::vector<uint32> start;      // index of the first weight, start[dstSize] is their count
+    std::vector<real32> weights;
+};
+
+
+BoxFilter::BoxFilter(uint32 srcSize, uint32 dstSize) : first(dstSize), start(dstSize + 1) {
+    real64 scale = static_cast<real64>(srcSize) / dstSize;
+
+    for (uint32 i = 0; i < dstSize; i++) {
+        real64 x0 = i * scale;
+        real64 x1 = Min_real64((i + 1) * scale, srcSize);
+
+        first[i] = static_cast<uint32>(x0);
+        start[i] = static_cast<uint32>(weights.size());
+
+        uint32 end = Min_uint32(static_cast<uint32>(std::ceil(x1)), srcSize);
+        for (uint32 j = first[i]; j < end; j++)
+            weights.push_back(static_cast<real32>((Min_real64(x1, j + 1) - Max_real64(x0, j)) / (x1 - x0)));
+    }
+    start[dstSize] = static_cast<uint32>(weights.size());
+}
+
+
+// Filters the interleaved pixels of src into dst, columns first and then rows
+template <typename T>
+static void boxFilter(const T *src, T *dst, uint32 srcWidth, uint32 planes,
+                      const BoxFilter &rowFilter, const BoxFilter &colFilter, real32 maxValue) {
+    uint32 dstHeight = static_cast<uint32>(rowFilter.first.size());
+    uint32 dstWidth  = static_cast<uint32>(colFilter.first.size());
+    uint32 srcRowStep = srcWidth * planes;
+
+    std::vector<real32> rowSum(srcRowStep);
+
+    for (uint32 row = 0; row < dstHeight; row++) {
+        std::fill(rowSum.begin(), rowSum.end(), 0.0f);
+
+        const T *srcRow = src + static_cast<uint64>(rowFilter.first[row]) * srcRowStep;
+        for (uint32 k = rowFilter.start[row]; k < rowFilter.start[row + 1]; k++, srcRow += srcRowStep) {
+            real32 weight = rowFilter.weights[k];
+            for (uint32 x = 0; x < srcRowStep; x++) rowSum[x] += weight * srcRow[x];
+        }
+
+        for (uint32 col = 0; col < dstWidth; col++) {
+            for (uint32 plane = 0; plane < planes; plane++) {
+                const real32 *sum = &rowSum[colFilter.first[col] * planes + plane];
+                real32 value = 0.0f;
+                for (uint32 k = colFilter.start[col]; k < colFilter.start[col + 1]; k++, sum += planes)
+                    value += colFilter.weights[k] * *sum;
+                *dst++ = static_cast<T>(Pin_real32(0.0f, value, maxValue) + 0.5f);
+            }
+        }
+    }
+}
+
+
+// Averages blocks of factor x factor 16-bit pixels, starting at the source origin; each
+// destination pixel is one block. Works on interleaved buffers, which the images can fill
+// much faster than the planar ones of dng_filter_task.
+class BlockAverageTask : public dng_area_task {
+public:
+    BlockAverageTask(const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOrigin, uint32 factor) :
+        m_srcImage(srcImage), m_dstImage(dstImage), m_srcOrigin(srcOrigin), m_factor(factor),
+        m_planes(Min_uint32(srcImage.Planes(), dstImage.Planes())) {}
+
+    virtual void Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer *sniffer);
+    virtual void Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer *sniffer);
+
+private:
+    dng_pixel_buffer Buffer(const dng_rect &area, void *data) const;
+
+    const dng_image &m_srcImage;
+    dng_image &m_dstImage;
+    dng_point m_srcOrigin;
+    uint32 m_factor, m_planes;
+
+    AutoPtr<dng_memory_block> m_srcBuffer[kMaxMPThreads];
+    AutoPtr<dng_memory_block> m_dstBuffer[kMaxMPThreads];
+    AutoPtr<dng_memory_block> m_sumBuffer[kMaxMPThreads];
+};
+
+
+dng_pixel_buffer BlockAverageTask::Buffer(const dng_rect &area, void *data) const {
+    dng_pixel_buffer buffer;
+    buffer.fArea = area;
+    buffer.fPlane = 0;
+    buffer.fPlanes = m_planes;
+    buffer.fRowStep = m_planes * area.W();
+    buffer.fColStep = m_planes;
+    buffer.fPlaneStep = 1;
+    buffer.fPixelType = ttShort;
+    buffer.fPixelSize = 2;
+    buffer.fData = data;
+    return buffer;
+}
+
+
+void BlockAverageTask::Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer * /* sniffer */) {
+    uint32 tilePixels = tileSize.h * tileSize.v * m_planes;
+    uint32 srcRow = tileSize.h * m_factor * m_planes;
+    for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++) {
+        m_srcBuffer[threadIndex].Reset(allocator->Allocate(tilePixels * m_factor * m_factor * sizeof(uint16)));
+        m_dstBuffer[threadIndex].Reset(allocator->Allocate(tilePixels * sizeof(uint16)));
+        m_sumBuffer[threadIndex].Reset(allocator->Allocate(srcRow * sizeof(uint32)));
+    }
+}
+
+
+void BlockAverageTask::Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer * /* sniffer */) {
+    int32 factor = static_cast<int32>(m_factor);
+    dng_rect srcArea(m_srcOrigin.v + tile.t * factor, m_srcOrigin.h + tile.l * factor,
+                     m_srcOrigin.v + tile.b * factor, m_srcOrigin.h + tile.r * factor);
+
+    dng_pixel_buffer srcBuffer(Buffer(srcArea, m_srcBuffer[threadIndex]->Buffer()));
+    dng_pixel_buffer dstBuffer(Buffer(tile, m_dstBuffer[threadIndex]->Buffer()));
+    m_srcImage.Get(srcBuffer);
+
+    uint32 srcRow = srcBuffer.fRowStep;
+    uint32 dstCols = tile.W();
+    uint32 blockSize = m_factor * m_factor;
+
+    // rounded-up reciprocal of the block size, divides exactly for sums below 2^32 / blockSize
+    uint64 reciprocal = ((static_cast<uint64>(1) << 32) + blockSize - 1) / blockSize;
+    uint32 *sums = m_sumBuffer[threadIndex]->Buffer_uint32();
+
+    const uint16 *sPtr = srcBuffer.ConstPixel_uint16(srcArea.t, srcArea.l);
+    uint16 *dPtr = dstBuffer.DirtyPixel_uint16(tile.t, tile.l);
+    for (int32 row = tile.t; row < tile.b; row++) {
+        // column sums of one row of blocks, then one sum per block and plane
+        std::fill(sums, sums + srcRow, 0);
+        for (uint32 k = 0; k < m_factor; k++, sPtr += srcRow)
+            for (uint32 x = 0; x < srcRow; x++) sums[x] += sPtr[x];
+
+        const uint32 *block = sums;
+        for (uint32 col = 0; col < dstCols; col++, block += m_factor * m_planes) {
+            for (uint32 plane = 0; plane < m_planes; plane++) {
+                uint32 total = blockSize / 2;
+                for (uint32 k = 0; k < m_factor; k++) total += block[k * m_planes + plane];
+                *dPtr++ = static_cast<uint16>((total * reciprocal) >> 32);
+            }
+        }
+    }
+
+    m_dstImage.Put(dstBuffer);
+}
+
+
+void PyramidRender::ResampleStage3(const dng_image &srcImage, dng_image &dstImage, const dng_rect &srcBounds) {
+    // largest block size that divides the source area and leaves the bicubic filter a factor of at
+    // least 2. Smaller blocks don't pay for the extra pass; the limit keeps block sums below 2^32 / 256.
+    real64 ratio = Min_real64(static_cast<real64>(srcBounds.W()) / dstImage.Width(),
+                              static_cast<real64>(srcBounds.H()) / dstImage.Height());
+    uint32 factor = Min_uint32(static_cast<uint32>(ratio / 2.0), kMaxBlockSize);
+    while ((factor >= kMinBlockSize) && ((srcBounds.W() % factor != 0) || (srcBounds.H() % factor != 0))) factor--;
+
+    if ((factor < kMinBlockSize) || (srcImage.PixelType() != ttShort)) {
+        dng_render::ResampleStage3(srcImage, dstImage, srcBounds);
+        return;
+    }
+
+    dng_rect blockBounds(srcBounds.H() / factor, srcBounds.W() / factor);
+    AutoPtr<dng_image> blockImage(fHost.Make_dng_image(blockBounds, srcImage.Planes(), ttShort));
+
+    BlockAverageTask task(srcImage, *blockImage, srcBounds.TL(), factor);
+    fHost.PerformAreaTask(task, blockBounds);
+
+    ResampleImage(fHost, *blockImage, dstImage, blockBounds, dstImage.Bounds(), dng_resample_bicubic::Get());
+}
+
+
+bool PyramidRender::UsesLut() const {
+    if ((m_lutSize < 2) || (m_lutSize > RenderLut::kMaxGridSize) || fNegative.IsMonochrome()) return false;
+
+    // profiles without hue/sat map and look table render faster exactly
+    const dng_camera_profile *profile = fNegative.ProfileByID(dng_camera_profile_id());
+    return (profile != NULL) && (profile->HasHueSatDeltas() || profile->HasLookTable());
+}
+
+
+void PyramidRender::RenderPixels(const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOffset) {
+    uint32 dstType = dstImage.PixelType();
+    dng_fingerprint fingerprint;
+    if (UsesLut() && (srcImage.PixelType() == ttShort) && (srcImage.Planes() == 3) && (dstImage.Planes() == 3) &&
+        ((dstType == ttByte) || (dstType == ttShort)))
+        fingerprint = RenderLut::Fingerprint(fNegative, *this, m_lutSize);
+
+    if (!fingerprint.IsValid()) {
+        dng_render::RenderPixels(srcImage, dstImage, srcOffset);
+        return;
+    }
+
+    std::shared_ptr<const RenderLut> lut(RenderLut::Find(fingerprint));
+    if (!lut) {
+        AutoPtr<dng_image> grid(RenderLut::MakeGrid(fHost, m_lutSize));
+        AutoPtr<dng_image> renderedGrid(fHost.Make_dng_image(grid->Bounds(), 3, ttFloat));
+        dng_render::RenderPixels(*grid, *renderedGrid, dng_point(0, 0));
+
+        lut = std::make_shared<const RenderLut>(m_lutSize, *renderedGrid);
+        RenderLut::Add(fingerprint, lut);
+    }
+    lut->Render(fHost, srcImage, dstImage, srcOffset);
+}
+
+
+dng_point PyramidRender::FinalSize(uint32 maximumSize) const {
+    // same as dng_render::Render()
+    dng_point size;
+    size.h = fNegative.DefaultFinalWidth();
+    size.v = fNegative.DefaultFinalHeight();
+
+    if ((maximumSize != 0) && (Max_uint32(size.h, size.v) > maximumSize)) {
+        real64 ratio = fNegative.AspectRatio();
+        if (ratio >= 1.0) {
+            size.h = maximumSize;
+            size.v = Max_uint32(1, Round_uint32(size.h / ratio));
+        }
+        else {
+            size.v = maximumSize;
+            size.h = Max_uint32(1, Round_uint32(size.v * ratio));
+        }
+    }
+    return size;
+}
+
+
+std::vector<std::unique_ptr<dng_image>> PyramidRender::RenderSizes(const std::vector<uint32> &maximumSizes) {
+    std::vector<std::unique_ptr<dng_image>> images(maximumSizes.size());
+    if (maximumSizes.empty()) return images;
+
+    uint32 largestSize = maximumSizes[0];
+    for (auto maximumSize : maximumSizes)
+        if ((maximumSize == 0) || ((largestSize != 0) && (maximumSize > largestSize))) largestSize = maximumSize;
+
+    SetMaximumSize(largestSize);
+    std::unique_ptr<dng_image> rendered(Render());
+
+    for (size_t i = 0; i < maximumSizes.size(); i++) {
+        dng_point size = FinalSize(maximumSizes[i]);
+        if (size == rendered->Size()) images[i].reset(rendered->Clone());
+        else images[i].reset(Downsample(fHost, *rendered, size));
+    }
+    return images;
+}
+
+
+dng_image* PyramidRender::Downsample(dng_host &host, const dng_image &srcImage, const dng_point &dstSize) {
+    uint32 pixelType = srcImage.PixelType();
+    if ((pixelType != ttByte) && (pixelType != ttShort)) ThrowProgramError("Unsupported pixel type for Downsample");
+
+    uint32 planes = srcImage.Planes();
+    uint32 pixelSize = srcImage.PixelSize();
+
+    dng_pixel_buffer srcBuffer;
+    srcBuffer.fArea = srcImage.Bounds();
+    srcBuffer.fPlane = 0;
+    srcBuffer.fPlanes = planes;
+    srcBuffer.fRowStep = planes * srcImage.Width();
+    srcBuffer.fColStep = planes;
+    srcBuffer.fPlaneStep = 1;
+    srcBuffer.fPixelType = pixelType;
+    srcBuffer.fPixelSize = pixelSize;
+
+    AutoPtr<dng_memory_block> srcBlock(host.Allocate(srcImage.Width() * srcImage.Height() * planes * pixelSize));
+    srcBuffer.fData = srcBlock->Buffer();
+    srcImage.Get(srcBuffer);
+
+    dng_pixel_buffer dstBuffer(srcBuffer);
+    dstBuffer.fArea = dng_rect(dstSize.v, dstSize.h);
+    dstBuffer.fRowStep = planes * dstSize.h;
+
+    AutoPtr<dng_memory_block> dstBlock(host.Allocate(dstSize.h * dstSize.v * planes * pixelSize));
+    dstBuffer.fData = dstBlock->Buffer();
+
+    BoxFilter rowFilter(srcImage.Height(), dstSize.v);
+    BoxFilter colFilter(srcImage.Width(), dstSize.h);
+
+    if (pixelType == ttByte)
+        boxFilter(srcBlock->Buffer_uint8(), dstBlock->Buffer_uint8(), srcImage.Width(), planes, rowFilter, colFilter, 255.0f);
+    else
+        boxFilter(srcBlock->Buffer_uint16(), dstBlock->Buffer_uint16(), srcImage.Width(), planes, rowFilter, colFilter, 65535.0f);
+
+    AutoPtr<dng_image> dstImage(host.Make_dng_image(dstBuffer.fArea, planes, pixelType));
+    dstImage->Put(dstBuffer);
+    return dstImage.Release();
+}
@@ -0,0 +1,73 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_render.h"
+#include "dng_point.h"
+
+#include <memory>
+#include <vector>
+
+/*
+  dng_render that renders the same negative at several sizes in one go.
+
+  Each Render() resamples the whole stage 3 image and runs the full colour pipeline on
+  the result. Here only the largest size is rendered that way; smaller ones are box-filtered
+  from the rendered image, which costs next to nothing for preview and thumbnail sizes.
+  Every image still has the dimensions Render() would give it for its maximum size.
+
+  Stage 3 is reduced to the largest size faster than by dng_render as well: for large
+  integer ratios, blocks of whole pixels are averaged first and only the remaining factor
+  (at least 2) is left to the bicubic filter, whose cost grows with the number of source pixels.
+
+  Optionally, the colours are looked up in a cached 3D LUT (see RenderLut) instead of running
+  the colour pipeline for every pixel. This pays off for profiles with a hue/sat map or look
+  table; matrix-only profiles are faster to render exactly with the vectorised colour kernels.
+*/
+class PyramidRender : public dng_render {
+public:
+    PyramidRender(dng_host &host, const dng_negative &negative) : dng_render(host, negative), m_lutSize(0) {}
+
+    // Renders through a 3D LUT with lutSize^3 points (2 to RenderLut::kMaxGridSize, e.g. 33 or 65),
+    // which is built on first use and shared by all renders with the same profile and settings.
+    // Only used for profiles with a hue/sat map or look table, others are rendered exactly anyway.
+    // 0 (the default) renders every pixel exactly.
+    void SetLutSize(uint32 lutSize) {m_lutSize = lutSize;}
+    uint32 LutSize() const {return m_lutSize;}
+
+    // Whether the colours of the negative are looked up in the LUT (for a 16-bit, 3-plane stage 3)
+    bool UsesLut() const;
+
+    // Renders one image for each maximum size (as for SetMaximumSize(), 0 is the full size), in the
+    // same order. MaximumSize() is left at the largest of them
+    std::vector<std::unique_ptr<dng_image>> RenderSizes(const std::vector<uint32> &maximumSizes);
+
+    // Size of the image Render() produces for this maximum size
+    dng_point FinalSize(uint32 maximumSize) const;
+
+    // Image of dstSize whose pixels are the area-weighted averages of the source pixels they cover
+    static dng_image* Downsample(dng_host &host, const dng_image &srcImage, const dng_point &dstSize);
+
+protected:
+    virtual void ResampleStage3(const dng_image &srcImage, dng_image &dstImage, const dng_rect &srcBounds);
+    virtual void RenderPixels(const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOffset);
+
+private:
+    uint32 m_lutSize;
+};
@@ -0,0 +1,408 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+
+#include "renderlut.h"
+
+#include "dng_host.h"
+#include "dng_image.h"
+#include "dng_negative.h"
+#include "dng_render.h"
+#include "dng_camera_profile.h"
+#include "dng_color_spec.h"
+#include "dng_color_space.h"
+#include "dng_1d_function.h"
+#include "dng_pixel_buffer.h"
+#include "dng_area_task.h"
+#include "dng_sdk_limits.h"
+#include "dng_memory.h"
+#include "dng_exceptions.h"
+#include "dng_tag_types.h"
+#include "dng_utils.h"
+
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <utility>
+
+
+// Samples of the curves that go into the fingerprint
+const uint32 kCurveSamples = 257;
+
+// Resolution and range of the histogram that Compare() takes the percentile from
+const real64 kDeltaEStep = 0.01;
+const uint32 kDeltaEBins = 10000;
+
+
+static void appendMatrix(std::vector<real64> &values, const dng_matrix &matrix) {
+    for (uint32 row = 0; row < matrix.Rows(); row++)
+        for (uint32 col = 0; col < matrix.Cols(); col++) values.push_back(matrix[row][col]);
+}
+
+
+static void appendCurve(std::vector<real64> &values, const dng_1d_function &curve) {
+    for (uint32 i = 0; i < kCurveSamples; i++) values.push_back(curve.Evaluate(static_cast<real64>(i) / (kCurveSamples - 1)));
+}
+
+
+// 3-plane buffer with interleaved pixels of area
+static dng_pixel_buffer interleavedBuffer(const dng_rect &area, uint32 pixelType, void *data) {
+    dng_pixel_buffer buffer;
+    buffer.fArea = area;
+    buffer.fPlane = 0;
+    buffer.fPlanes = 3;
+    buffer.fRowStep = 3 * area.W();
+    buffer.fColStep = 3;
+    buffer.fPlaneStep = 1;
+    buffer.fPixelType = pixelType;
+    buffer.fPixelSize = TagTypeSize(pixelType);
+    buffer.fData = data;
+    return buffer;
+}
+
+
+dng_fingerprint RenderLut::Fingerprint(const dng_negative &negative, const dng_render &render, uint32 gridSize) {
+    if (negative.IsMonochrome()) return dng_fingerprint();
+
+    // the parameters dng_render_task derives its tables from, found the same way
+    dng_camera_profile_id profileID;
+    AutoPtr<dng_color_spec> spec(negative.MakeColorSpec(profileID));
+    if (render.WhiteXY().IsValid())       spec->SetWhiteXY(render.WhiteXY());
+    else if (negative.HasCameraNeutral()) spec->SetWhiteXY(spec->NeutralToXY(negative.CameraNeutral()));
+    else if (negative.HasCameraWhiteXY()) spec->SetWhiteXY(negative.CameraWhiteXY());
+    else                                  spec->SetWhiteXY(D55_xy_coord());
+
+    std::vector<real64> values;
+    values.push_back(gridSize);
+    values.push_back(spec->WhiteXY().x);
+    values.push_back(spec->WhiteXY().y);
+    for (uint32 i = 0; i < spec->CameraWhite().Count(); i++) values.push_back(spec->CameraWhite()[i]);
+    appendMatrix(values, spec->CameraToPCS());
+
+    values.push_back(render.Exposure() + negative.TotalBaselineExposure(profileID) - std::log(negative.Stage3Gain()) / std::log(2.0));
+    values.push_back(render.Shadows() * negative.ShadowScale() * negative.Stage3Gain());
+    appendCurve(values, render.ToneCurve());
+
+    appendMatrix(values, render.FinalSpace().MatrixFromPCS());
+    appendCurve(values, render.FinalSpace().GammaFunction());
+
+    dng_md5_printer printer;
+    printer.Process(values.data(), static_cast<uint32>(values.size() * sizeof(real64)));
+
+    // hue/sat maps and look table
+    const dng_camera_profile *profile = negative.ProfileByID(profileID);
+    if (profile != NULL) printer.Process(profile->Fingerprint().data, sizeof(profile->Fingerprint().data));
+
+    return printer.Result();
+}
+
+
+dng_image* RenderLut::MakeGrid(dng_host &host, uint32 gridSize) {
+    if ((gridSize < 2) || (gridSize > kMaxGridSize)) ThrowProgramError("Unsupported grid size for RenderLut");
+
+    std::vector<real32> points(gridSize);
+    for (uint32 i = 0; i < gridSize; i++)
+        points[i] = static_cast<real32>(dng_function_GammaEncode_sRGB::Get().EvaluateInverse(static_cast<real64>(i) / (gridSize - 1)));
+
+    dng_rect bounds(gridSize * gridSize, gridSize);
+    std::vector<real32> camera(3 * gridSize * gridSize * gridSize);
+
+    real32 *dPtr = camera.data();
+    for (uint32 b = 0; b < gridSize; b++)
+        for (uint32 g = 0; g < gridSize; g++)
+            for (uint32 r = 0; r < gridSize; r++) {
+                *dPtr++ = points[r];
+                *dPtr++ = points[g];
+                *dPtr++ = points[b];
+            }
+
+    AutoPtr<dng_image> grid(host.Make_dng_image(bounds, 3, ttFloat));
+    grid->Put(interleavedBuffer(bounds, ttFloat, camera.data()));
+    return grid.Release();
+}
+
+
+RenderLut::RenderLut(uint32 gridSize, const dng_image &renderedGrid) :
+    m_gridSize(gridSize), m_colours(gridSize * gridSize * gridSize), m_shaper(65536) {
+    dng_rect bounds(gridSize * gridSize, gridSize);
+    if ((gridSize < 2) || (gridSize > kMaxGridSize) || (renderedGrid.Bounds() != bounds) || (renderedGrid.Planes() != 3))
+        ThrowProgramError("Rendered grid doesn't match RenderLut");
+
+    std::vector<real32> rgb(3 * m_colours.size());
+    dng_pixel_buffer buffer(interleavedBuffer(bounds, ttFloat, rgb.data()));
+    renderedGrid.Get(buffer);
+
+    for (size_t i = 0; i < m_colours.size(); i++) {
+        Colour colour = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (uint32 plane = 0; plane < 3; plane++) colour[plane] = Pin_real32(0.0f, rgb[3 * i + plane], 1.0f);
+        m_colours[i] = colour;
+    }
+
+    for (uint32 value = 0; value < 65536; value++)
+        m_shaper[value] = static_cast<real32>(dng_function_GammaEncode_sRGB::Get().Evaluate(value / 65535.0) * (gridSize - 1));
+}
+
+
+inline RenderLut::Colour RenderLut::Lookup(const uint16 *camera) const {
+    real32 x = m_shaper[camera[0]];
+    real32 y = m_shaper[camera[1]];
+    real32 z = m_shaper[camera[2]];
+
+    uint32 last = m_gridSize - 2;
+    uint32 i = Min_uint32(static_cast<uint32>(x), last);
+    uint32 j = Min_uint32(static_cast<uint32>(y), last);
+    uint32 k = Min_uint32(static_cast<uint32>(z), last);
+    x -= i; y -= j; z -= k;
+
+    uint32 stepR = 1, stepG = m_gridSize, stepB = stepG * m_gridSize;
+
+    // the tetrahedron runs from the cell's first corner to its opposite one, along the axes in
+    // order of decreasing fraction. Picked without branches, which images with noise or fine
+    // detail would mispredict all the time; ties go to red before green before blue.
+    real32 f1 = Max_real32(x, Max_real32(y, z));
+    real32 f3 = Min_real32(x, Min_real32(y, z));
+    real32 f2 = x + y + z - f1 - f3;
+    uint32 step1 = ((x >= y) && (x >= z)) ? stepR : ((y >= z) ? stepG : stepB);
+    uint32 step3 = ((z <= x) && (z <= y)) ? stepB : ((y <= x) ? stepG : stepR);
+    uint32 step2 = stepR + stepG + stepB - step1 - step3;
+
+    const Colour *c0 = &m_colours[k * stepB + j * stepG + i];
+    const Colour *c1 = c0 + step1;
+    const Colour *c2 = c1 + step2;
+    const Colour *c3 = c2 + step3;
+    return *c0 + f1 * (*c1 - *c0) + f2 * (*c2 - *c1) + f3 * (*c3 - *c2);
+}
+
+
+// Looks up interleaved 16-bit pixels tile by tile
+class RenderLut::RenderTask : public dng_area_task {
+public:
+    RenderTask(const RenderLut &lut, const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOffset) :
+        m_lut(lut), m_srcImage(srcImage), m_dstImage(dstImage), m_srcOffset(srcOffset) {}
+
+    virtual void Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer *sniffer);
+    virtual void Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer *sniffer);
+
+private:
+    const RenderLut &m_lut;
+    const dng_image &m_srcImage;
+    dng_image &m_dstImage;
+    dng_point m_srcOffset;
+
+    AutoPtr<dng_memory_block> m_srcBuffer[kMaxMPThreads];
+    AutoPtr<dng_memory_block> m_dstBuffer[kMaxMPThreads];
+};
+
+
+void RenderLut::RenderTask::Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer * /* sniffer */) {
+    uint32 tileValues = tileSize.h * tileSize.v * 3;
+    for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++) {
+        m_srcBuffer[threadIndex].Reset(allocator->Allocate(tileValues * sizeof(uint16)));
+        m_dstBuffer[threadIndex].Reset(allocator->Allocate(tileValues * m_dstImage.PixelSize()));
+    }
+}
+
+
+void RenderLut::RenderTask::Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer * /* sniffer */) {
+    dng_pixel_buffer srcBuffer(interleavedBuffer(tile + m_srcOffset, ttShort, m_srcBuffer[threadIndex]->Buffer()));
+    dng_pixel_buffer dstBuffer(interleavedBuffer(tile, m_dstImage.PixelType(), m_dstBuffer[threadIndex]->Buffer()));
+    m_srcImage.Get(srcBuffer);
+
+    const uint16 *sPtr = m_srcBuffer[threadIndex]->Buffer_uint16();
+    uint32 count = tile.W() * tile.H();
+
+    if (dstBuffer.fPixelType == ttByte) {
+        uint8 *dPtr = m_dstBuffer[threadIndex]->Buffer_uint8();
+        for (uint32 i = 0; i < count; i++, sPtr += 3, dPtr += 3) {
+            Colour rgb = m_lut.Lookup(sPtr) * 255.0f + 0.5f;
+            for (uint32 plane = 0; plane < 3; plane++) dPtr[plane] = static_cast<uint8>(rgb[plane]);
+        }
+    }
+    else {
+        uint16 *dPtr = m_dstBuffer[threadIndex]->Buffer_uint16();
+        for (uint32 i = 0; i < count; i++, sPtr += 3, dPtr += 3) {
+            Colour rgb = m_lut.Lookup(sPtr) * 65535.0f + 0.5f;
+            for (uint32 plane = 0; plane < 3; plane++) dPtr[plane] = static_cast<uint16>(rgb[plane]);
+        }
+    }
+
+    m_dstImage.Put(dstBuffer);
+}
+
+
+void RenderLut::Render(dng_host &host, const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOffset) const {
+    if ((srcImage.PixelType() != ttShort) || (srcImage.Planes() != 3) || (dstImage.Planes() != 3) ||
+        ((dstImage.PixelType() != ttByte) && (dstImage.PixelType() != ttShort)))
+        ThrowProgramError("Unsupported images for RenderLut");
+
+    RenderTask task(*this, srcImage, dstImage, srcOffset);
+    host.PerformAreaTask(task, dstImage.Bounds());
+}
+
+
+static std::mutex gCacheMutex;
+static std::list<std::pair<dng_fingerprint, std::shared_ptr<const RenderLut>>> gCache;  // most recently used first
+
+
+std::shared_ptr<const RenderLut> RenderLut::Find(const dng_fingerprint &fingerprint) {
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    for (auto entry = gCache.begin(); entry != gCache.end(); ++entry) {
+        if (entry->first == fingerprint) {
+            gCache.splice(gCache.begin(), gCache, entry);
+            return entry->second;
+        }
+    }
+    return std::shared_ptr<const RenderLut>();
+}
+
+
+void RenderLut::Add(const dng_fingerprint &fingerprint, const std::shared_ptr<const RenderLut> &lut) {
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    for (auto entry = gCache.begin(); entry != gCache.end(); ++entry) {
+        if (entry->first == fingerprint) {
+            gCache.erase(entry);
+            break;
+        }
+    }
+    gCache.push_front(std::make_pair(fingerprint, lut));
+    if (gCache.size() > kCacheSize) gCache.pop_back();
+}
+
+
+// CIELAB of linear XYZ, relative to white
+static void xyzToLab(const dng_vector &xyz, const dng_vector &white, real64 *lab) {
+    real64 f[3];
+    for (uint32 i = 0; i < 3; i++) {
+        real64 t = xyz[i] / white[i];
+        f[i] = (t > 216.0 / 24389.0) ? std::cbrt(t) : (t * 24389.0 / 27.0 + 16.0) / 116.0;
+    }
+    lab[0] = 116.0 * f[1] - 16.0;
+    lab[1] = 500.0 * (f[0] - f[1]);
+    lab[2] = 200.0 * (f[1] - f[2]);
+}
+
+
+static real64 deltaE2000(const real64 *lab1, const real64 *lab2) {
+    const real64 kDegrees = 180.0 / 3.14159265358979323846;
+    const real64 k25Pow7 = 6103515625.0;
+
+    real64 cBar = (std::hypot(lab1[1], lab1[2]) + std::hypot(lab2[1], lab2[2])) / 2.0;
+    real64 cBar7 = std::pow(cBar, 7.0);
+    real64 g = 0.5 * (1.0 - std::sqrt(cBar7 / (cBar7 + k25Pow7)));
+
+    real64 a1 = (1.0 + g) * lab1[1], a2 = (1.0 + g) * lab2[1];
+    real64 c1 = std::hypot(a1, lab1[2]), c2 = std::hypot(a2, lab2[2]);
+    real64 h1 = (c1 == 0.0) ? 0.0 : std::atan2(lab1[2], a1) * kDegrees;
+    real64 h2 = (c2 == 0.0) ? 0.0 : std::atan2(lab2[2], a2) * kDegrees;
+    if (h1 < 0.0) h1 += 360.0;
+    if (h2 < 0.0) h2 += 360.0;
+
+    real64 dL = lab2[0] - lab1[0];
+    real64 dC = c2 - c1;
+    real64 dh = 0.0, hBar = h1 + h2;
+    if (c1 * c2 != 0.0) {
+        dh = h2 - h1;
+        if (dh > 180.0) dh -= 360.0;
+        else if (dh < -180.0) dh += 360.0;
+
+        if (std::fabs(h1 - h2) <= 180.0) hBar = (h1 + h2) / 2.0;
+        else hBar = (h1 + h2 + ((h1 + h2 < 360.0) ? 360.0 : -360.0)) / 2.0;
+    }
+    real64 dH = 2.0 * std::sqrt(c1 * c2) * std::sin(dh / 2.0 / kDegrees);
+
+    real64 lBar = (lab1[0] + lab2[0]) / 2.0;
+    real64 cBarPrime = (c1 + c2) / 2.0;
+    real64 t = 1.0 - 0.17 * std::cos((hBar - 30.0) / kDegrees) + 0.24 * std::cos(2.0 * hBar / kDegrees)
+                   + 0.32 * std::cos((3.0 * hBar + 6.0) / kDegrees) - 0.20 * std::cos((4.0 * hBar - 63.0) / kDegrees);
+    real64 dTheta = 30.0 * std::exp(-((hBar - 275.0) / 25.0) * ((hBar - 275.0) / 25.0));
+    real64 cBarPrime7 = std::pow(cBarPrime, 7.0);
+    real64 rC = 2.0 * std::sqrt(cBarPrime7 / (cBarPrime7 + k25Pow7));
+    real64 sL = 1.0 + 0.015 * (lBar - 50.0) * (lBar - 50.0) / std::sqrt(20.0 + (lBar - 50.0) * (lBar - 50.0));
+    real64 sC = 1.0 + 0.045 * cBarPrime;
+    real64 sH = 1.0 + 0.015 * cBarPrime * t;
+    real64 rT = -std::sin(2.0 * dTheta / kDegrees) * rC;
+
+    real64 l = dL / sL, c = dC / sC, h = dH / sH;
+    return std::sqrt(l * l + c * c + h * h + rT * c * h);
+}
+
+
+RenderLut::Difference RenderLut::Compare(const dng_image &image1, const dng_image &image2, const dng_color_space &space) {
+    uint32 pixelType = image1.PixelType();
+    if ((image1.Bounds() != image2.Bounds()) || (image1.Planes() != 3) || (image2.Planes() != 3) ||
+        (image2.PixelType() != pixelType) || ((pixelType != ttByte) && (pixelType != ttShort)))
+        ThrowProgramError("Unsupported images for RenderLut::Compare");
+
+    // linear values of all pixel values, instead of decoding every pixel
+    uint32 maxValue = (pixelType == ttByte) ? 255 : 65535;
+    std::vector<real64> linear(maxValue + 1);
+    for (uint32 value = 0; value <= maxValue; value++)
+        linear[value] = space.GammaFunction().EvaluateInverse(static_cast<real64>(value) / maxValue);
+
+    dng_matrix toPCS(space.MatrixToPCS());
+    dng_vector white(PCStoXYZ());
+
+    uint32 width = image1.Width();
+    std::vector<uint16> row1(3 * width), row2(3 * width);
+    std::vector<uint64> histogram(kDeltaEBins + 1);
+    real64 sum = 0.0, maxDeltaE = 0.0;
+
+    for (int32 row = image1.Bounds().t; row < image1.Bounds().b; row++) {
+        dng_rect area(row, image1.Bounds().l, row + 1, image1.Bounds().r);
+        dng_pixel_buffer buffer1(interleavedBuffer(area, ttShort, row1.data()));
+        dng_pixel_buffer buffer2(interleavedBuffer(area, ttShort, row2.data()));
+        image1.Get(buffer1);
+        image2.Get(buffer2);
+
+        for (uint32 col = 0; col < width; col++) {
+            const uint16 *pixel1 = &row1[3 * col], *pixel2 = &row2[3 * col];
+            real64 deltaE = 0.0;
+            if ((pixel1[0] != pixel2[0]) || (pixel1[1] != pixel2[1]) || (pixel1[2] != pixel2[2])) {
+                dng_vector rgb1(3), rgb2(3);
+                for (uint32 plane = 0; plane < 3; plane++) {
+                    rgb1[plane] = linear[pixel1[plane]];
+                    rgb2[plane] = linear[pixel2[plane]];
+                }
+                real64 lab1[3], lab2[3];
+                xyzToLab(toPCS * rgb1, white, lab1);
+                xyzToLab(toPCS * rgb2, white, lab2);
+                deltaE = deltaE2000(lab1, lab2);
+            }
+
+            sum += deltaE;
+            maxDeltaE = Max_real64(maxDeltaE, deltaE);
+            histogram[Min_uint32(static_cast<uint32>(deltaE / kDeltaEStep), kDeltaEBins)]++;
+        }
+    }
+
+    uint64 count = static_cast<uint64>(width) * image1.Height();
+    Difference difference;
+    difference.mean = (count > 0) ? sum / count : 0.0;
+    difference.max = maxDeltaE;
+    difference.percentile99 = maxDeltaE;
+
+    uint64 covered = 0;
+    for (uint32 bin = 0; bin < kDeltaEBins; bin++) {
+        covered += histogram[bin];
+        if (covered * 100 >= count * 99) {
+            difference.percentile99 = Min_real64((bin + 1) * kDeltaEStep, maxDeltaE);
+            break;
+        }
+    }
+    return difference;
+}
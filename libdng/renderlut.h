@@ -0,0 +1,92 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "dng_fingerprint.h"
+#include "dng_point.h"
+#include "dng_types.h"
+
+#include <memory>
+#include <vector>
+
+class dng_host;
+class dng_image;
+class dng_negative;
+class dng_render;
+class dng_color_space;
+
+/*
+  The colour pipeline of dng_render - camera matrix, hue/sat map, exposure, look table, tone
+  curve and encoding of the final space - baked into a 3D LUT.
+
+  The LUT holds the exactly rendered colours of gridSize^3 points of the camera space. The points
+  are evenly spaced after an sRGB gamma on each camera channel, which puts more of them into the
+  shadows, where the rendering changes fastest. A pixel is interpolated from the four points of
+  the tetrahedron around it.
+
+  A LUT is built by rendering its points through the exact pipeline, so it only pays off when it
+  is reused: LUTs are cached for the whole process, keyed by a fingerprint of everything the
+  rendering depends on - the camera profile, white balance, exposure, tone curve and final space.
+*/
+class RenderLut {
+public:
+    static const uint32 kMaxGridSize = 129;
+
+    // Fingerprint of the colour rendering of negative with the settings of render, at this
+    // grid size. Invalid if the negative can't be rendered through a LUT (monochrome).
+    static dng_fingerprint Fingerprint(const dng_negative &negative, const dng_render &render, uint32 gridSize);
+
+    // Float image of the camera values of the grid points, gridSize wide and gridSize^2 high
+    static dng_image* MakeGrid(dng_host &host, uint32 gridSize);
+
+    // LUT from the MakeGrid image rendered to 3 float planes
+    RenderLut(uint32 gridSize, const dng_image &renderedGrid);
+
+    // Renders the 16-bit stage 3 pixels of srcImage, from srcOffset on, into dstImage
+    // (3 planes, 8 or 16 bits)
+    void Render(dng_host &host, const dng_image &srcImage, dng_image &dstImage, const dng_point &srcOffset) const;
+
+    // Cached LUT of this fingerprint, null if there is none. The cache keeps the most
+    // recently used LUTs; if two threads build the same one, the second replaces the first.
+    static std::shared_ptr<const RenderLut> Find(const dng_fingerprint &fingerprint);
+    static void Add(const dng_fingerprint &fingerprint, const std::shared_ptr<const RenderLut> &lut);
+
+    static const uint32 kCacheSize = 8;
+
+    // CIEDE2000 colour differences between two renderings (same size, 3 planes, 8 or 16 bits)
+    // in the colour space space
+    struct Difference {
+        real64 mean, percentile99, max;
+    };
+    static Difference Compare(const dng_image &image1, const dng_image &image2, const dng_color_space &space);
+
+private:
+    class RenderTask;
+
+    // RGB and padding, so that each grid point is a single load
+    typedef real32 Colour __attribute__((vector_size(4 * sizeof(real32))));
+
+    // Interpolated colour of a 16-bit camera pixel, in [0, 1]
+    Colour Lookup(const uint16 *camera) const;
+
+    uint32 m_gridSize;
+    std::vector<Colour> m_colours;  // every grid point, red index fastest, then green
+    std::vector<real32> m_shaper;   // grid coordinate of every 16-bit camera value
+};
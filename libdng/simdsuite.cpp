@@ -0,0 +1,836 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "simdsuite.h"
+
+#include "dng_bottlenecks.h"
+#include "dng_reference.h"
+#include "dng_1d_table.h"
+#include "dng_hue_sat_map.h"
+#include "dng_matrix.h"
+#include "dng_resample.h"
+
+#include <mutex>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+
+static const char *simdLevel = "none";
+
+
+#if SIMD_X86
+
+// -----------------------------------------------------------------------------------------
+// ExtractPlanes16: only 4 -> 3 planes (3-colour images in LibRaw's 4-plane image buffers)
+// is vectorised, everything else is rare enough for the reference code
+
+// Drops the 4th plane of the two pixels in p, the 12 remaining bytes end up at the bottom
+__attribute__((target("sse2")))
+static inline __m128i packPixels4to3(__m128i p) {
+    const __m128i mask = _mm_set_epi32(0, 0, 0x0000FFFF, 0xFFFFFFFF);
+    return _mm_or_si128(_mm_and_si128(p, mask), _mm_slli_si128(_mm_and_si128(_mm_srli_si128(p, 8), mask), 6));
+}
+
+__attribute__((target("sse2")))
+static void sse2ExtractPlanes16(const uint16 *sPtr, uint16 *dPtr, uint32 count, uint32 sPlanes, uint32 dPlanes) {
+    if ((sPlanes != 4) || (dPlanes != 3)) {
+        RefExtractPlanes16(sPtr, dPtr, count, sPlanes, dPlanes);
+        return;
+    }
+
+    // 8 pixels per iteration: 4 input vectors -> 3 output vectors
+    uint32 blocks = count / 8;
+    for (uint32 block = 0; block < blocks; block++, sPtr += 32, dPtr += 24) {
+        __m128i a = packPixels4to3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr)));
+        __m128i b = packPixels4to3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr + 8)));
+        __m128i c = packPixels4to3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr + 16)));
+        __m128i d = packPixels4to3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr + 24)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr),      _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr + 8),  _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr + 16), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+
+    RefExtractPlanes16(sPtr, dPtr, count - blocks * 8, sPlanes, dPlanes);
+}
+
+
+__attribute__((target("avx2")))
+static void avx2ExtractPlanes16(const uint16 *sPtr, uint16 *dPtr, uint32 count, uint32 sPlanes, uint32 dPlanes) {
+    if ((sPlanes != 4) || (dPlanes != 3)) {
+        RefExtractPlanes16(sPtr, dPtr, count, sPlanes, dPlanes);
+        return;
+    }
+
+    // Pack each 128-bit lane to 12 bytes, then move the two lanes' 3 dwords next to each other
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+                                             0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    // 8 pixels per iteration: 2 input vectors -> 48 output bytes. Every store writes 8 bytes too
+    // many that are overwritten by the next one, so stop while there are at least 2 pixels left.
+    uint32 blocks = (count >= 10) ? (count - 2) / 8 : 0;
+    for (uint32 block = 0; block < blocks; block++, sPtr += 32, dPtr += 24) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sPtr));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sPtr + 16));
+        a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(a, shuffle), permute);
+        b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, shuffle), permute);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dPtr), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dPtr + 12), b);
+    }
+
+    sse2ExtractPlanes16(sPtr, dPtr, count - blocks * 8, sPlanes, dPlanes);
+}
+
+// -----------------------------------------------------------------------------------------
+// Baseline colour kernels of dng_render. They are written once with GCC's generic vectors and
+// instantiated for SSE4.1 (4 lanes) and AVX2 (8 lanes). Every lane does the operations of the
+// reference code in the same order (and without FMA), so the results match it exactly for the
+// inputs the render pipeline produces; leftover pixels at the end of a row go to the reference.
+
+#define SIMD_INLINE __attribute__((always_inline)) static inline
+
+template <int N>
+struct SimdVector {
+    typedef real32 Float __attribute__((vector_size(N * sizeof(real32))));
+    typedef int32 Int __attribute__((vector_size(N * sizeof(int32))));
+    typedef uint8 Byte __attribute__((vector_size(N)));
+};
+
+// The helpers hand their results back through references: GCC checks the ABI of every function
+// that returns a vector, inlined or not, and warns about 32-byte ones in code not compiled for
+// AVX - at the end of the file, where no pragma around the helpers reaches.
+template <typename V>
+SIMD_INLINE void loadVector(V &v, const real32 *p) {
+    memcpy(&v, p, sizeof(V));
+}
+
+template <typename V>
+SIMD_INLINE void storeVector(real32 *p, const V &v) {
+    memcpy(p, &v, sizeof(V));
+}
+
+// x = Min_real32(x, y) and x = Pin_real32(x), including the results for NaNs and signed zeros
+template <typename V>
+SIMD_INLINE void minVector(V &x, const V &y) {x = (x < y) ? x : y;}
+
+template <typename V>
+SIMD_INLINE void pinVector(V &x) {
+    minVector<V>(x, V() + 1.0f);
+    x = (V() > x) ? V() : x;
+}
+
+// y = dng_1d_table::Interpolate(x). The index is pinned to the table only to keep the loads
+// inside it, which changes nothing for arguments in the table's range
+template <int N>
+SIMD_INLINE void interpolateVector(typename SimdVector<N>::Float &y, const real32 *table, const typename SimdVector<N>::Float &x) {
+    typedef typename SimdVector<N>::Float Float;
+    typedef typename SimdVector<N>::Int Int;
+
+    const int32 tableSize = dng_1d_table::kTableSize;
+
+    Float scaled = x * static_cast<real32>(tableSize);
+    Int index = __builtin_convertvector(scaled, Int);
+    Float fract = scaled - __builtin_convertvector(index, Float);
+
+    index = (index < 0) ? Int() : index;
+    index = (index > tableSize) ? (Int() + tableSize) : index;
+
+    Float y0, y1;
+    for (int lane = 0; lane < N; lane++) {
+        y0[lane] = table[index[lane]];
+        y1[lane] = table[index[lane] + 1];
+    }
+    y = y0 * (1.0f - fract) + y1 * fract;
+}
+
+
+template <int N>
+SIMD_INLINE uint32 baselineABCtoRGB(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC,
+                                    real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                    const dng_vector &cameraWhite, const dng_matrix &cameraToRGB) {
+    typedef typename SimdVector<N>::Float Float;
+
+    real32 clipA = static_cast<real32>(cameraWhite[0]);
+    real32 clipB = static_cast<real32>(cameraWhite[1]);
+    real32 clipC = static_cast<real32>(cameraWhite[2]);
+
+    real32 m[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) m[i][j] = static_cast<real32>(cameraToRGB[i][j]);
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        Float A, B, C;
+        loadVector(A, sPtrA + col);
+        loadVector(B, sPtrB + col);
+        loadVector(C, sPtrC + col);
+        minVector<Float>(A, Float() + clipA);
+        minVector<Float>(B, Float() + clipB);
+        minVector<Float>(C, Float() + clipC);
+
+        Float r = m[0][0] * A + m[0][1] * B + m[0][2] * C;
+        Float g = m[1][0] * A + m[1][1] * B + m[1][2] * C;
+        Float b = m[2][0] * A + m[2][1] * B + m[2][2] * C;
+        pinVector(r);
+        pinVector(g);
+        pinVector(b);
+        storeVector(dPtrR + col, r);
+        storeVector(dPtrG + col, g);
+        storeVector(dPtrB + col, b);
+    }
+    return col;
+}
+
+
+template <int N>
+SIMD_INLINE uint32 baselineRGBtoRGB(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                    real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                    const dng_matrix &matrix) {
+    typedef typename SimdVector<N>::Float Float;
+
+    real32 m[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) m[i][j] = static_cast<real32>(matrix[i][j]);
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        Float R, G, B;
+        loadVector(R, sPtrR + col);
+        loadVector(G, sPtrG + col);
+        loadVector(B, sPtrB + col);
+
+        Float r = m[0][0] * R + m[0][1] * G + m[0][2] * B;
+        Float g = m[1][0] * R + m[1][1] * G + m[1][2] * B;
+        Float b = m[2][0] * R + m[2][1] * G + m[2][2] * B;
+        pinVector(r);
+        pinVector(g);
+        pinVector(b);
+        storeVector(dPtrR + col, r);
+        storeVector(dPtrG + col, g);
+        storeVector(dPtrB + col, b);
+    }
+    return col;
+}
+
+
+template <int N>
+SIMD_INLINE uint32 baseline1DTable(const real32 *sPtr, real32 *dPtr, uint32 count, const dng_1d_table &table) {
+    typedef typename SimdVector<N>::Float Float;
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        Float x;
+        loadVector(x, sPtr + col);
+        interpolateVector<N>(x, table.Table(), x);
+        storeVector(dPtr + col, x);
+    }
+    return col;
+}
+
+
+// The reference sorts each pixel into one of seven cases; here every channel is classified as
+// the largest, smallest or middle one of the same case, so that ties are resolved the same way
+template <int N>
+SIMD_INLINE uint32 baselineRGBTone(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                   real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                   const dng_1d_table &table) {
+    typedef typename SimdVector<N>::Float Float;
+    typedef typename SimdVector<N>::Int Int;
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        Float r, g, b;
+        loadVector(r, sPtrR + col);
+        loadVector(g, sPtrG + col);
+        loadVector(b, sPtrB + col);
+
+        Int rFirst = (r >= g);
+        Int case1 = rFirst & (g > b);
+        Int case2 = rFirst & ~case1 & (b > r);
+        Int case3 = rFirst & ~case1 & ~case2 & (b > g);
+        Int case4 = rFirst & ~case1 & ~case2 & ~case3;
+        Int case5 = ~rFirst & (r >= b);
+        Int case6 = ~rFirst & ~case5 & (b > g);
+        Int case7 = ~rFirst & ~case5 & ~case6;
+
+        Int rLargest = case1 | case3 | case4, rSmallest = case6 | case7;
+        Int gLargest = case5 | case7,         gSmallest = case2 | case3 | case4;
+        Int bLargest = case2 | case6,         bSmallest = case1 | case4 | case5;
+
+        Float largest  = rLargest ? r : (gLargest ? g : b);
+        Float smallest = rSmallest ? r : (gSmallest ? g : b);
+        Float middle   = (case1 | case6) ? g : ((case2 | case5) ? r : b);
+
+        // case 4 (r >= g == b) has no middle channel, g and b both take the smallest
+        Float toneLargest, toneSmallest;
+        interpolateVector<N>(toneLargest, table.Table(), largest);
+        interpolateVector<N>(toneSmallest, table.Table(), smallest);
+        Float toneMiddle   = toneSmallest + ((toneLargest - toneSmallest) * (middle - smallest) / (largest - smallest));
+
+        storeVector(dPtrR + col, rLargest ? toneLargest : (rSmallest ? toneSmallest : toneMiddle));
+        storeVector(dPtrG + col, gLargest ? toneLargest : (gSmallest ? toneSmallest : toneMiddle));
+        storeVector(dPtrB + col, bLargest ? toneLargest : (bSmallest ? toneSmallest : toneMiddle));
+    }
+    return col;
+}
+
+
+// One row of RefCopyAreaR32_8 (Pin_Overrange, scaling and rounding) from three planes to
+// interleaved pixels, which is how dng_image::Put stores a rendered image in an 8-bit one
+template <int N>
+SIMD_INLINE uint32 copyRowR32_8(const real32 *sPtr, uint8 *dPtr, uint32 count, int32 sPlaneStep, real32 scale) {
+    typedef typename SimdVector<N>::Float Float;
+    typedef typename SimdVector<N>::Int Int;
+    typedef typename SimdVector<N>::Byte Byte;
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        uint8 planes[3][N];
+        for (uint32 plane = 0; plane < 3; plane++) {
+            Float x;
+            loadVector(x, sPtr + plane * sPlaneStep + col);
+            x = ((x > 0.0f) & (x <= 1.0f)) ? x : ((x > 0.5f) ? (Float() + 1.0f) : Float());
+
+            Byte bytes = __builtin_convertvector(__builtin_convertvector(x * scale + 0.5f, Int), Byte);
+            memcpy(planes[plane], &bytes, sizeof(Byte));
+        }
+
+        uint8 *pixel = dPtr + col * 3;
+        for (uint32 i = 0; i < N; i++, pixel += 3) {
+            pixel[0] = planes[0][i];
+            pixel[1] = planes[1][i];
+            pixel[2] = planes[2][i];
+        }
+    }
+    return col;
+}
+
+
+// The hue/sat map entries entry and entry + 1 (HSBModify, three floats each) of every lane:
+// e[k] holds float k of the pair. Gathered through memory, which is as fast as inserting the
+// lanes one by one and lets GCC see that all of e is written.
+template <int N>
+SIMD_INLINE void gatherEntries(typename SimdVector<N>::Float (&e)[6], const real32 *table, const typename SimdVector<N>::Int &entry) {
+    real32 lanes[6][N];
+    for (int lane = 0; lane < N; lane++) {
+        const real32 *p = table + 3 * entry[lane];
+        for (int k = 0; k < 6; k++) lanes[k][lane] = p[k];
+    }
+    for (int k = 0; k < 6; k++) loadVector(e[k], lanes[k]);
+}
+
+
+template <int N>
+SIMD_INLINE uint32 baselineHueSatMap(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                     real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                     const dng_hue_sat_map &lut, const dng_1d_table *encodeTable,
+                                     const dng_1d_table *decodeTable) {
+    typedef typename SimdVector<N>::Float Float;
+    typedef typename SimdVector<N>::Int Int;
+
+    uint32 hueDivisions, satDivisions, valDivisions;
+    lut.GetDivisions(hueDivisions, satDivisions, valDivisions);
+
+    real32 hScale = (hueDivisions < 2) ? 0.0f : (hueDivisions * (1.0f / 6.0f));
+    real32 sScale = static_cast<real32>(satDivisions - 1);
+    real32 vScale = static_cast<real32>(valDivisions - 1);
+
+    int32 maxHueIndex0 = hueDivisions - 1;
+    int32 maxSatIndex0 = satDivisions - 2;
+    int32 maxValIndex0 = valDivisions - 2;
+
+    const bool hasTable = (encodeTable != NULL) && (encodeTable->Table() != NULL) &&
+                          (decodeTable != NULL) && (decodeTable->Table() != NULL);
+
+    // HSBModify entries are three consecutive floats
+    const real32 *tableBase = reinterpret_cast<const real32*>(lut.GetConstDeltas());
+
+    int32 hueStep = satDivisions;
+    int32 valStep = hueDivisions * hueStep;
+
+    uint32 col = 0;
+    for (; col + N <= count; col += N) {
+        Float r, g, b;
+        loadVector(r, sPtrR + col);
+        loadVector(g, sPtrG + col);
+        loadVector(b, sPtrB + col);
+
+        // DNG_RGBtoHSV, maximum and minimum as by Max_real32 and Min_real32
+        Float v = (g > b) ? g : b;
+        v = (r > v) ? r : v;
+        Float minimum = (g < b) ? g : b;
+        Float gap = v - ((r < minimum) ? r : minimum);
+
+        Float hR = (g - b) / gap;
+        hR = (hR < 0.0f) ? (hR + 6.0f) : hR;
+        Float h = (r == v) ? hR : ((g == v) ? (2.0f + (b - r) / gap) : (4.0f + (r - g) / gap));
+        Float s = gap / v;
+
+        Int colored = (gap > 0.0f);
+        h = colored ? h : Float();
+        s = colored ? s : Float();
+
+        Float vEncoded = v;
+
+        Float hueShift, satScale, valScale;
+
+        Float hScaled = h * hScale;
+        Float sScaled = s * sScale;
+
+        Int hIndex0 = __builtin_convertvector(hScaled, Int);
+        Int sIndex0 = __builtin_convertvector(sScaled, Int);
+        sIndex0 = (sIndex0 < maxSatIndex0) ? sIndex0 : (Int() + maxSatIndex0);
+
+        Int hIndex1 = hIndex0 + 1;
+        Int hueWraps = (hIndex0 >= maxHueIndex0);
+        hIndex0 = hueWraps ? (Int() + maxHueIndex0) : hIndex0;
+        hIndex1 = hueWraps ? Int() : hIndex1;
+
+        Float hFract1 = hScaled - __builtin_convertvector(hIndex0, Float);
+        Float sFract1 = sScaled - __builtin_convertvector(sIndex0, Float);
+        Float hFract0 = 1.0f - hFract1;
+        Float sFract0 = 1.0f - sFract1;
+
+        Int entry00 = hIndex0 * hueStep + sIndex0;
+        Int entry01 = entry00 + (hIndex1 - hIndex0) * hueStep;
+
+        if (valDivisions < 2) {
+            // "2.5D" table: hue and saturation only
+            Float e00[6], e01[6];
+            gatherEntries<N>(e00, tableBase, entry00);
+            gatherEntries<N>(e01, tableBase, entry01);
+
+            Float hueShift0 = hFract0 * e00[0] + hFract1 * e01[0];
+            Float satScale0 = hFract0 * e00[1] + hFract1 * e01[1];
+            Float valScale0 = hFract0 * e00[2] + hFract1 * e01[2];
+
+            Float hueShift1 = hFract0 * e00[3] + hFract1 * e01[3];
+            Float satScale1 = hFract0 * e00[4] + hFract1 * e01[4];
+            Float valScale1 = hFract0 * e00[5] + hFract1 * e01[5];
+
+            hueShift = sFract0 * hueShift0 + sFract1 * hueShift1;
+            satScale = sFract0 * satScale0 + sFract1 * satScale1;
+            valScale = sFract0 * valScale0 + sFract1 * valScale1;
+        }
+        else {
+            if (hasTable) {
+                pinVector(vEncoded);
+                interpolateVector<N>(vEncoded, encodeTable->Table(), vEncoded);
+            }
+
+            Float vScaled = vEncoded * vScale;
+            Int vIndex0 = __builtin_convertvector(vScaled, Int);
+            vIndex0 = (vIndex0 < maxValIndex0) ? vIndex0 : (Int() + maxValIndex0);
+
+            Float vFract1 = vScaled - __builtin_convertvector(vIndex0, Float);
+            Float vFract0 = 1.0f - vFract1;
+
+            entry00 += vIndex0 * valStep;
+            entry01 += vIndex0 * valStep;
+
+            Float e00[6], e01[6], e10[6], e11[6];
+            gatherEntries<N>(e00, tableBase, entry00);
+            gatherEntries<N>(e01, tableBase, entry01);
+            gatherEntries<N>(e10, tableBase, entry00 + valStep);
+            gatherEntries<N>(e11, tableBase, entry01 + valStep);
+
+            Float hueShift0 = vFract0 * (hFract0 * e00[0] + hFract1 * e01[0]) + vFract1 * (hFract0 * e10[0] + hFract1 * e11[0]);
+            Float satScale0 = vFract0 * (hFract0 * e00[1] + hFract1 * e01[1]) + vFract1 * (hFract0 * e10[1] + hFract1 * e11[1]);
+            Float valScale0 = vFract0 * (hFract0 * e00[2] + hFract1 * e01[2]) + vFract1 * (hFract0 * e10[2] + hFract1 * e11[2]);
+
+            Float hueShift1 = vFract0 * (hFract0 * e00[3] + hFract1 * e01[3]) + vFract1 * (hFract0 * e10[3] + hFract1 * e11[3]);
+            Float satScale1 = vFract0 * (hFract0 * e00[4] + hFract1 * e01[4]) + vFract1 * (hFract0 * e10[4] + hFract1 * e11[4]);
+            Float valScale1 = vFract0 * (hFract0 * e00[5] + hFract1 * e01[5]) + vFract1 * (hFract0 * e10[5] + hFract1 * e11[5]);
+
+            hueShift = sFract0 * hueShift0 + sFract1 * hueShift1;
+            satScale = sFract0 * satScale0 + sFract1 * satScale1;
+            valScale = sFract0 * valScale0 + sFract1 * valScale1;
+        }
+
+        hueShift *= (6.0f / 360.0f);
+        h += hueShift;
+        s *= satScale;
+        minVector<Float>(s, Float() + 1.0f);
+        vEncoded *= valScale;
+        pinVector(vEncoded);
+        if (hasTable) interpolateVector<N>(v, decodeTable->Table(), vEncoded);
+        else v = vEncoded;
+
+        // DNG_HSVtoRGB
+        h = (h < 0.0f) ? (h + 6.0f) : h;
+        h = (h >= 6.0f) ? (h - 6.0f) : h;
+
+        Int i = __builtin_convertvector(h, Int);
+        Float f = h - __builtin_convertvector(i, Float);
+
+        Float p = v * (1.0f - s);
+        Float q = v * (1.0f - s * f);
+        Float t = v * (1.0f - s * (1.0f - f));
+
+        r = ((i == 0) | (i == 5)) ? v : ((i == 1) ? q : ((i == 4) ? t : p));
+        g = ((i == 1) | (i == 2)) ? v : ((i == 0) ? t : ((i == 3) ? q : p));
+        b = ((i == 3) | (i == 4)) ? v : ((i == 2) ? t : ((i == 5) ? q : p));
+
+        Int saturated = (s > 0.0f);
+        storeVector(dPtrR + col, saturated ? r : v);
+        storeVector(dPtrG + col, saturated ? g : v);
+        storeVector(dPtrB + col, saturated ? b : v);
+    }
+    return col;
+}
+
+
+// Kernel entry points per instruction set: vector part first, reference for the remaining pixels
+#define SIMD_COLOUR_KERNELS(isa, instructionSet, N) \
+__attribute__((target(instructionSet))) \
+static void isa##BaselineABCtoRGB(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC, \
+                                  real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, \
+                                  const dng_vector &cameraWhite, const dng_matrix &cameraToRGB) { \
+    uint32 done = baselineABCtoRGB<N>(sPtrA, sPtrB, sPtrC, dPtrR, dPtrG, dPtrB, count, cameraWhite, cameraToRGB); \
+    RefBaselineABCtoRGB(sPtrA + done, sPtrB + done, sPtrC + done, dPtrR + done, dPtrG + done, dPtrB + done, \
+                        count - done, cameraWhite, cameraToRGB); \
+} \
+\
+__attribute__((target(instructionSet))) \
+static void isa##BaselineRGBtoRGB(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB, \
+                                  real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, const dng_matrix &matrix) { \
+    uint32 done = baselineRGBtoRGB<N>(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, matrix); \
+    RefBaselineRGBtoRGB(sPtrR + done, sPtrG + done, sPtrB + done, dPtrR + done, dPtrG + done, dPtrB + done, \
+                        count - done, matrix); \
+} \
+\
+__attribute__((target(instructionSet))) \
+static void isa##Baseline1DTable(const real32 *sPtr, real32 *dPtr, uint32 count, const dng_1d_table &table) { \
+    uint32 done = baseline1DTable<N>(sPtr, dPtr, count, table); \
+    RefBaseline1DTable(sPtr + done, dPtr + done, count - done, table); \
+} \
+\
+__attribute__((target(instructionSet))) \
+static void isa##BaselineRGBTone(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB, \
+                                 real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, const dng_1d_table &table) { \
+    uint32 done = baselineRGBTone<N>(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, table); \
+    RefBaselineRGBTone(sPtrR + done, sPtrG + done, sPtrB + done, dPtrR + done, dPtrG + done, dPtrB + done, \
+                       count - done, table); \
+} \
+\
+__attribute__((target(instructionSet))) \
+static void isa##BaselineHueSatMap(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB, \
+                                   real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, \
+                                   const dng_hue_sat_map &lut, const dng_1d_table *encodeTable, \
+                                   const dng_1d_table *decodeTable) { \
+    uint32 done = baselineHueSatMap<N>(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, lut, encodeTable, decodeTable); \
+    RefBaselineHueSatMap(sPtrR + done, sPtrG + done, sPtrB + done, dPtrR + done, dPtrG + done, dPtrB + done, \
+                         count - done, lut, encodeTable, decodeTable); \
+} \
+\
+__attribute__((target(instructionSet))) \
+static void isa##CopyAreaR32_8(const real32 *sPtr, uint8 *dPtr, uint32 rows, uint32 cols, uint32 planes, \
+                               int32 sRowStep, int32 sColStep, int32 sPlaneStep, \
+                               int32 dRowStep, int32 dColStep, int32 dPlaneStep, uint32 pixelRange) { \
+    if ((planes != 3) || (sColStep != 1) || (dColStep != 3) || (dPlaneStep != 1)) { \
+        RefCopyAreaR32_8(sPtr, dPtr, rows, cols, planes, sRowStep, sColStep, sPlaneStep, \
+                         dRowStep, dColStep, dPlaneStep, pixelRange); \
+        return; \
+    } \
+    for (uint32 row = 0; row < rows; row++, sPtr += sRowStep, dPtr += dRowStep) { \
+        uint32 done = copyRowR32_8<N>(sPtr, dPtr, cols, sPlaneStep, (real32) pixelRange); \
+        RefCopyAreaR32_8(sPtr + done, dPtr + done * 3, 1, cols - done, 3, sRowStep, 1, sPlaneStep, \
+                         dRowStep, 3, 1, pixelRange); \
+    } \
+}
+
+SIMD_COLOUR_KERNELS(sse41, "sse4.1", 4)
+SIMD_COLOUR_KERNELS(avx2, "avx2", 8)
+
+#undef SIMD_COLOUR_KERNELS
+
+
+// -----------------------------------------------------------------------------------------
+// Resampling kernels of dng_resample_task. The 16-bit kernels multiply-add pairs of samples
+// with pmaddwd, which takes signed words: samples are moved into the signed range by
+// subtracting 32768, and 32768 times the sum of the weights is added back. The integer
+// results are exactly those of the reference.
+
+// Sum of the weights scaled by 32768, as unsigned so that it wraps like the vector sums
+static inline uint32 resampleBias(const int16 *wPtr, uint32 wCount) {
+    uint32 weightSum = 0;
+    for (uint32 k = 0; k < wCount; k++) weightSum += static_cast<uint32>(static_cast<int32>(wPtr[k]));
+    return weightSum << 15;
+}
+
+// Two weights as the 32-bit pair pmaddwd multiplies two interleaved rows with
+static inline int32 weightPair(int16 w0, int16 w1) {
+    return static_cast<int32>(static_cast<uint16>(w0) | (static_cast<uint32>(static_cast<uint16>(w1)) << 16));
+}
+
+
+__attribute__((target("sse4.1")))
+static void sse41ResampleDown16(const uint16 *sPtr, uint16 *dPtr, uint32 sCount, int32 sRowStep,
+                                const int16 *wPtr, uint32 wCount, uint32 pixelRange) {
+    const __m128i start = _mm_set1_epi32(static_cast<int32>(8192 + resampleBias(wPtr, wCount)));
+    const __m128i sign = _mm_set1_epi16(static_cast<int16>(0x8000));
+    const __m128i maxValue = _mm_set1_epi32(static_cast<int32>(pixelRange));
+
+    // 8 pixels per iteration, two source rows at a time
+    uint32 col = 0;
+    for (; col + 8 <= sCount; col += 8) {
+        __m128i lo = start, hi = start;
+        const uint16 *s = sPtr + col;
+        uint32 k = 0;
+        for (; k + 2 <= wCount; k += 2, s += 2 * sRowStep) {
+            __m128i a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), sign);
+            __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + sRowStep)), sign);
+            __m128i w = _mm_set1_epi32(weightPair(wPtr[k], wPtr[k + 1]));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        if (k < wCount) {
+            __m128i a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), sign);
+            __m128i w = _mm_set1_epi32(weightPair(wPtr[k], 0));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, a), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, a), w));
+        }
+
+        lo = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(lo, 14), _mm_setzero_si128()), maxValue);
+        hi = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(hi, 14), _mm_setzero_si128()), maxValue);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr + col), _mm_packus_epi32(lo, hi));
+    }
+
+    RefResampleDown16(sPtr + col, dPtr + col, sCount - col, sRowStep, wPtr, wCount, pixelRange);
+}
+
+
+__attribute__((target("avx2")))
+static void avx2ResampleDown16(const uint16 *sPtr, uint16 *dPtr, uint32 sCount, int32 sRowStep,
+                               const int16 *wPtr, uint32 wCount, uint32 pixelRange) {
+    const __m256i start = _mm256_set1_epi32(static_cast<int32>(8192 + resampleBias(wPtr, wCount)));
+    const __m256i sign = _mm256_set1_epi16(static_cast<int16>(0x8000));
+    const __m256i maxValue = _mm256_set1_epi32(static_cast<int32>(pixelRange));
+
+    // 16 pixels per iteration. Unpacking works within 128-bit lanes, which packing reverses.
+    uint32 col = 0;
+    for (; col + 16 <= sCount; col += 16) {
+        __m256i lo = start, hi = start;
+        const uint16 *s = sPtr + col;
+        uint32 k = 0;
+        for (; k + 2 <= wCount; k += 2, s += 2 * sRowStep) {
+            __m256i a = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)), sign);
+            __m256i b = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + sRowStep)), sign);
+            __m256i w = _mm256_set1_epi32(weightPair(wPtr[k], wPtr[k + 1]));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        if (k < wCount) {
+            __m256i a = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)), sign);
+            __m256i w = _mm256_set1_epi32(weightPair(wPtr[k], 0));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, a), w));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, a), w));
+        }
+
+        lo = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(lo, 14), _mm256_setzero_si256()), maxValue);
+        hi = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(hi, 14), _mm256_setzero_si256()), maxValue);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dPtr + col), _mm256_packus_epi32(lo, hi));
+    }
+
+    sse41ResampleDown16(sPtr + col, dPtr + col, sCount - col, sRowStep, wPtr, wCount, pixelRange);
+}
+
+
+// Dot product of the weights of one destination pixel with its source samples: blocks of 8
+// taps (16 with AVX2) are vectorised, the remaining taps are added up one by one
+__attribute__((target("sse4.1")))
+static inline int32 sse41Dot16(const uint16 *s, const int16 *w, uint32 wCount, uint32 k, __m128i sum) {
+    const __m128i sign = _mm_set1_epi16(static_cast<int16>(0x8000));
+    const __m128i ones = _mm_set1_epi16(1);
+
+    // sum holds the products of the offset samples, bias the scaled weights
+    __m128i bias = _mm_setzero_si128();
+    for (; k + 8 <= wCount; k += 8) {
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + k));
+        __m128i samples = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + k)), sign);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(samples, weights));
+        bias = _mm_add_epi32(bias, _mm_madd_epi16(weights, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_slli_epi32(bias, 15));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+
+    uint32 total = static_cast<uint32>(_mm_cvtsi128_si32(sum));
+    for (; k < wCount; k++) total += static_cast<uint32>(w[k] * static_cast<int32>(s[k]));
+    return static_cast<int32>(total);
+}
+
+
+__attribute__((target("sse4.1")))
+static void sse41ResampleAcross16(const uint16 *sPtr, uint16 *dPtr, uint32 dCount, const int32 *coord,
+                                  const int16 *wPtr, uint32 wCount, uint32 wStep, uint32 pixelRange) {
+    for (uint32 j = 0; j < dCount; j++) {
+        int32 sCoord = coord[j];
+        const int16 *w = wPtr + (sCoord & kResampleSubsampleMask) * wStep;
+        const uint16 *s = sPtr + (sCoord >> kResampleSubsampleBits);
+
+        int32 total = sse41Dot16(s, w, wCount, 0, _mm_setzero_si128());
+        dPtr[j] = static_cast<uint16>(Pin_int32(0, (total + 8192) >> 14, pixelRange));
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void avx2ResampleAcross16(const uint16 *sPtr, uint16 *dPtr, uint32 dCount, const int32 *coord,
+                                 const int16 *wPtr, uint32 wCount, uint32 wStep, uint32 pixelRange) {
+    const __m256i sign = _mm256_set1_epi16(static_cast<int16>(0x8000));
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    for (uint32 j = 0; j < dCount; j++) {
+        int32 sCoord = coord[j];
+        const int16 *w = wPtr + (sCoord & kResampleSubsampleMask) * wStep;
+        const uint16 *s = sPtr + (sCoord >> kResampleSubsampleBits);
+
+        __m256i sum = _mm256_setzero_si256();
+        __m256i bias = _mm256_setzero_si256();
+        uint32 k = 0;
+        for (; k + 16 <= wCount; k += 16) {
+            __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + k));
+            __m256i samples = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + k)), sign);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(samples, weights));
+            bias = _mm256_add_epi32(bias, _mm256_madd_epi16(weights, ones));
+        }
+        sum = _mm256_add_epi32(sum, _mm256_slli_epi32(bias, 15));
+
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        int32 total = sse41Dot16(s, w, wCount, k, half);
+        dPtr[j] = static_cast<uint16>(Pin_int32(0, (total + 8192) >> 14, pixelRange));
+    }
+}
+
+
+// Same structure as RefResampleDown32 (including its treatment of a single weight), but the
+// sums are kept in registers instead of the destination row
+template <int N>
+SIMD_INLINE uint32 resampleDown32(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                                  const real32 *wPtr, uint32 wCount) {
+    typedef typename SimdVector<N>::Float Float;
+
+    uint32 col = 0;
+    for (; col + N <= sCount; col += N) {
+        const real32 *s = sPtr + col;
+        Float sample;
+        loadVector(sample, s);
+        Float total = wPtr[0] * sample;
+        s += sRowStep;
+        for (uint32 j = 1; j < wCount - 1; j++, s += sRowStep) {
+            loadVector(sample, s);
+            total += wPtr[j] * sample;
+        }
+        loadVector(sample, s);
+        total += wPtr[wCount - 1] * sample;
+        pinVector(total);
+        storeVector(dPtr + col, total);
+    }
+    return col;
+}
+
+
+__attribute__((target("sse4.1")))
+static void sse41ResampleDown32(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                                const real32 *wPtr, uint32 wCount) {
+    uint32 done = resampleDown32<4>(sPtr, dPtr, sCount, sRowStep, wPtr, wCount);
+    RefResampleDown32(sPtr + done, dPtr + done, sCount - done, sRowStep, wPtr, wCount);
+}
+
+
+__attribute__((target("avx2")))
+static void avx2ResampleDown32(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                               const real32 *wPtr, uint32 wCount) {
+    uint32 done = resampleDown32<8>(sPtr, dPtr, sCount, sRowStep, wPtr, wCount);
+    RefResampleDown32(sPtr + done, dPtr + done, sCount - done, sRowStep, wPtr, wCount);
+}
+
+#undef SIMD_INLINE
+
+
+// Points the suite's colour and resampling kernels to those of an instruction set
+#define SET_KERNELS(suite, isa) \
+    suite.BaselineABCtoRGB  = isa##BaselineABCtoRGB; \
+    suite.BaselineRGBtoRGB  = isa##BaselineRGBtoRGB; \
+    suite.Baseline1DTable   = isa##Baseline1DTable; \
+    suite.BaselineRGBTone   = isa##BaselineRGBTone; \
+    suite.BaselineHueSatMap = isa##BaselineHueSatMap; \
+    suite.CopyAreaR32_8     = isa##CopyAreaR32_8; \
+    suite.ResampleDown16    = isa##ResampleDown16; \
+    suite.ResampleDown32    = isa##ResampleDown32; \
+    suite.ResampleAcross16  = isa##ResampleAcross16;
+
+#endif
+
+
+bool SetSimdKernels(dng_suite &suite, const char *level) {
+#if SIMD_X86
+    __builtin_cpu_init();
+
+    if (strcmp(level, "avx2") == 0) {
+        if (!__builtin_cpu_supports("avx2")) return false;
+        suite.ExtractPlanes16 = avx2ExtractPlanes16;
+        SET_KERNELS(suite, avx2)
+        return true;
+    }
+    if (strcmp(level, "sse4.1") == 0) {
+        if (!__builtin_cpu_supports("sse4.1")) return false;
+        suite.ExtractPlanes16 = sse2ExtractPlanes16;
+        SET_KERNELS(suite, sse41)
+        return true;
+    }
+    if (strcmp(level, "sse2") == 0) {
+        if (!__builtin_cpu_supports("sse2")) return false;
+        suite.ExtractPlanes16 = sse2ExtractPlanes16;
+        return true;
+    }
+#endif
+    return false;
+}
+
+
+static void installSuite() {
+    static const char *levels[] = {"avx2", "sse4.1", "sse2"};
+    for (auto level : levels) {
+        if (SetSimdKernels(gDNGSuite, level)) {
+            simdLevel = level;
+            return;
+        }
+    }
+}
+
+
+void InstallSimdSuite() {
+    static std::once_flag installed;
+    std::call_once(installed, installSuite);
+}
+
+
+const char* SimdSuiteLevel() {
+    InstallSimdSuite();
+    return simdLevel;
+}
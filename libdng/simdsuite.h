@@ -0,0 +1,40 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_bottlenecks.h"
+
+/*
+  Vectorised replacements for routines of the DNG SDK's gDNGSuite.
+
+  The instruction set is picked at runtime, so the binary still runs on CPUs without
+  the extensions. Entries without an implementation for the CPU (or on non-x86
+  platforms) keep their reference implementation.
+*/
+
+// Installs the fastest supported kernels into gDNGSuite. Safe to call repeatedly from any thread.
+void InstallSimdSuite();
+
+// Name of the instruction set that was selected ("avx2", "sse4.1", "sse2" or "none")
+const char* SimdSuiteLevel();
+
+// Points the entries of suite that have a version for the given instruction set ("avx2", "sse4.1"
+// or "sse2") to it and leaves the others alone. False if the CPU doesn't support the instruction
+// set - this is how the tests reach the kernels of every level the machine can run.
+bool SetSimdKernels(dng_suite &suite, const char *level);
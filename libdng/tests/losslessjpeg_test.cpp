@@ -0,0 +1,205 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+
+
+/*
+  Encodes tiles with the lossless JPEG encoder of the DNG SDK and decodes them again. The samples
+  must come back exactly, for every bit depth and component count raw2dng writes, with Huffman
+  tables from every row (the default) and from every 16th row (-f). Tile widths are odd and
+  heights not a multiple of the row step. The data produces every difference category up to the
+  16-bit one and codes both shorter and longer than the decoder's lookup table, so the encoder's
+  bit buffer flushes at every alignment and both decoding paths are used. A truncated stream has
+  to fail, and a tile whose differences all lie in rows that -f doesn't count has to decode.
+*/
+
+#include "dng_exceptions.h"
+#include "dng_lossless_jpeg.h"
+#include "dng_memory.h"
+#include "dng_memory_stream.h"
+#include "dng_stream.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+static int failures = 0;
+
+
+class VectorSpooler : public dng_spooler {
+public:
+    virtual void Spool(const void *data, uint32 count) {
+        const uint8 *bytes = static_cast<const uint8*>(data);
+        m_data.insert(m_data.end(), bytes, bytes + count);
+    }
+
+    std::vector<uint16> Samples() const {
+        std::vector<uint16> samples(m_data.size() / sizeof(uint16));
+        if (!samples.empty()) memcpy(samples.data(), m_data.data(), samples.size() * sizeof(uint16));
+        return samples;
+    }
+
+private:
+    std::vector<uint8> m_data;
+};
+
+
+// Random walks whose step size category halves in frequency with every category, a few rows of
+// random samples and jumps between 0, full and half scale. The rare categories get Huffman codes
+// longer than the 12 bits of the decoder's lookup table.
+static std::vector<uint16> makeTile(uint32 rows, uint32 cols, uint32 channels, uint32 bitDepth, uint32 seed) {
+    const int32 maximum = (1 << bitDepth) - 1;
+    std::mt19937 random(seed);
+    std::geometric_distribution<int32> category(0.5);
+    std::uniform_int_distribution<int32> any(0, maximum);
+    // 0 -> half scale + 1 is the difference 32768 at 16 bits, the one that needs no extra bits
+    const int32 jumps[3] = {0, maximum / 2 + 1, maximum};
+
+    std::vector<uint16> tile(rows * cols * channels);
+    for (uint32 row = 0; row < rows; row++)
+        for (uint32 col = 0; col < cols; col++)
+            for (uint32 channel = 0; channel < channels; channel++) {
+                uint32 index = (row * cols + col) * channels + channel;
+                int32 value;
+                if ((row % 11 == 5) && (col < 6)) value = jumps[col % 3];
+                else if ((row % 37 == 3) && (col > cols / 2)) value = any(random);
+                else if (col == 0) value = maximum / (4 + channel);
+                else {
+                    int32 step = 1 << std::min(int32(bitDepth) - 1, category(random));
+                    value = tile[index - channels];
+                    value += ((value + step <= maximum) && (random() & 1)) ? step : -std::min(step, value);
+                }
+                tile[index] = uint16(std::max(0, std::min(maximum, value)));
+            }
+    return tile;
+}
+
+
+static std::vector<uint8> encode(const std::vector<uint16> &tile, uint32 rows, uint32 cols, uint32 channels,
+                                 uint32 bitDepth, uint32 huffmanRowStep) {
+    dng_memory_stream stream(gDefaultDNGMemoryAllocator);
+    EncodeLosslessJPEG(tile.data(), rows, cols, channels, bitDepth, cols * channels, channels, stream, huffmanRowStep);
+    stream.Flush();
+
+    std::vector<uint8> bytes(uint32(stream.Length()));
+    stream.SetReadPosition(0);
+    stream.Get(bytes.data(), uint32(bytes.size()));
+    return bytes;
+}
+
+
+static std::vector<uint16> decode(const std::vector<uint8> &bytes, uint32 samples) {
+    dng_stream stream(bytes.data(), uint32(bytes.size()));
+    VectorSpooler spooler;
+    uint32 size = samples * uint32(sizeof(uint16));
+    DecodeLosslessJPEG(stream, spooler, size, size, false);
+    return spooler.Samples();
+}
+
+
+static void testRoundTrip(uint32 rows, uint32 cols, uint32 channels, uint32 bitDepth, uint32 huffmanRowStep) {
+    std::vector<uint16> tile = makeTile(rows, cols, channels, bitDepth, rows * 131 + bitDepth * 7 + channels);
+
+    char name[80];
+    snprintf(name, sizeof(name), "%2u bits, %u component%s, %3ux%-3u, row step %2u",
+             bitDepth, channels, (channels == 1) ? " " : "s", cols, rows, huffmanRowStep);
+
+    try {
+        std::vector<uint8> bytes = encode(tile, rows, cols, channels, bitDepth, huffmanRowStep);
+        std::vector<uint16> decoded = decode(bytes, uint32(tile.size()));
+        if (decoded != tile) {
+            failures++;
+            fprintf(stderr, "FAILED: %s: decoded samples differ\n", name);
+            return;
+        }
+        printf("%-50s %7u bytes, identical\n", name, uint32(bytes.size()));
+    }
+    catch (const dng_exception &exception) {
+        failures++;
+        fprintf(stderr, "FAILED: %s: error %d\n", name, int(exception.ErrorCode()));
+    }
+}
+
+
+// With -f the tables are counted on rows 0, 16, 32, ... only. Make those flat, so that every
+// difference except 0 is missing from the counts and has to get its code from the seeded counts.
+static void testUnsampledDifferences() {
+    const uint32 rows = 40, cols = 65, channels = 2, bitDepth = 14;
+    std::vector<uint16> tile = makeTile(rows, cols, channels, bitDepth, 6);
+    for (uint32 row = 0; row < rows; row += 16)
+        std::fill(tile.begin() + row * cols * channels, tile.begin() + (row + 1) * cols * channels, uint16(1000));
+
+    std::vector<uint8> bytes = encode(tile, rows, cols, channels, bitDepth, 16);
+    bool identical = false;
+    try {
+        identical = (decode(bytes, uint32(tile.size())) == tile);
+    }
+    catch (const dng_exception &) {
+    }
+    if (!identical) {
+        failures++;
+        fprintf(stderr, "FAILED: differences missing from the sampled rows\n");
+    }
+    printf("%-50s %7u bytes, %s\n", "differences only in unsampled rows", uint32(bytes.size()), identical ? "identical" : "differs");
+}
+
+
+// Cut off in the middle of the entropy-coded data and just before the end marker
+static void testTruncated() {
+    const uint32 rows = 64, cols = 63;
+    std::vector<uint16> tile = makeTile(rows, cols, 2, 14, 5);
+    std::vector<uint8> bytes = encode(tile, rows, cols, 2, 14, 1);
+
+    for (size_t length : {bytes.size() / 2, bytes.size() - 16}) {
+        std::vector<uint8> truncated(bytes.begin(), bytes.begin() + length);
+        bool failed = false;
+        try {
+            decode(truncated, uint32(tile.size()));
+        }
+        catch (const dng_exception &) {
+            failed = true;
+        }
+        if (!failed) {
+            failures++;
+            fprintf(stderr, "FAILED: stream truncated to %u of %u bytes was decoded\n", uint32(length), uint32(bytes.size()));
+        }
+    }
+    printf("%-50s fails\n", "truncated stream");
+}
+
+
+int main() {
+    for (uint32 bitDepth : {12u, 14u, 16u})
+        for (uint32 channels : {1u, 2u})
+            for (uint32 huffmanRowStep : {1u, 16u}) {
+                testRoundTrip(200, 255, channels, bitDepth, huffmanRowStep);
+                testRoundTrip(5, 33, channels, bitDepth, huffmanRowStep);  // fewer rows than the step
+            }
+    testUnsampledDifferences();
+    testTruncated();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all tiles decode to the encoded samples\n");
+    return 0;
+}
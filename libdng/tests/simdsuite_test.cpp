@@ -0,0 +1,436 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+
+/*
+  Checks the vectorised kernels of every instruction set the CPU supports against the reference
+  code of the DNG SDK. Rows of every length up to a few vectors are run, so each length of the
+  leftover part that goes to the reference is covered, starting at an aligned and a misaligned
+  address. The inputs mix random pixels with the special cases of the kernels: ties between
+  channels, zeros, grey pixels and values that get clipped. Plane extraction must match exactly.
+*/
+
+#include "simdsuite.h"
+
+#include "dng_reference.h"
+#include "dng_1d_function.h"
+#include "dng_1d_table.h"
+#include "dng_hue_sat_map.h"
+#include "dng_matrix.h"
+#include "dng_memory.h"
+#include "dng_resample.h"
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// The kernels do the reference's operations in the same order, so this is mostly headroom for
+// compilers that contract the reference's arithmetic differently
+static const real32 kTolerance = 1e-5f;
+
+// Row lengths 0 to 40 cover all leftovers of 4 and 8 lanes several times, 1001 a long row
+static const uint32 kLengths = 41;
+static const uint32 kLongLength = 1001;
+static const uint32 kPadding = 8;
+
+static int failures = 0;
+
+
+struct Planes {
+    std::vector<real32> r, g, b;
+};
+
+
+class PowerCurve : public dng_1d_function {
+public:
+    explicit PowerCurve(real64 power) : m_power(power) {}
+    virtual real64 Evaluate(real64 x) const {return pow(x, m_power);}
+
+private:
+    real64 m_power;
+};
+
+
+class SCurve : public dng_1d_function {
+public:
+    virtual real64 Evaluate(real64 x) const {return x * x * (3.0 - 2.0 * x);}
+};
+
+
+// Special cases first, then random pixels. Overrange inputs go up to 2, unit ones stay in 0..1
+// (the tables and the hue/sat map only ever see pinned values).
+static Planes makeInput(bool overrange, uint32 seed) {
+    static const real32 unitPixels[][3] = {
+        {0, 0, 0}, {1, 1, 1}, {0.5f, 0.5f, 0.5f}, {0.7f, 0.7f, 0.2f}, {0.7f, 0.2f, 0.7f}, {0.2f, 0.7f, 0.7f},
+        {0.3f, 0.3f, 0.9f}, {0.9f, 0.3f, 0.3f}, {0.3f, 0.9f, 0.3f}, {0.9f, 0.3f, 0.9f}, {1, 0, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 1, 0}, {0, 0.5f, 1}, {0.25f, 0, 0}, {1e-6f, 0, 1e-6f}, {1, 0.8f, 0.9f}};
+    static const real32 overrangePixels[][3] = {
+        {2, 2, 2}, {1.5f, 0.2f, 0.1f}, {1.2f, 0.9f, 1}, {0, 1.5f, 0}, {1, 0.81f, 0.9f}, {0.1f, 0.1f, 1.8f}};
+
+    std::vector<const real32*> specials;
+    for (const auto &pixel : unitPixels) specials.push_back(pixel);
+    if (overrange) for (const auto &pixel : overrangePixels) specials.push_back(pixel);
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<real32> value(0.0f, overrange ? 2.0f : 1.0f);
+
+    // every other pixel is special, so that they land in every lane and in the leftovers
+    Planes planes;
+    for (uint32 i = 0; i < kLongLength + kPadding; i++) {
+        if ((i & 1) && (i / 2 < 4 * specials.size())) {
+            const real32 *pixel = specials[(i / 2) % specials.size()];
+            planes.r.push_back(pixel[0]);
+            planes.g.push_back(pixel[1]);
+            planes.b.push_back(pixel[2]);
+        }
+        else {
+            planes.r.push_back(value(random));
+            planes.g.push_back(value(random));
+            planes.b.push_back(value(random));
+        }
+    }
+    return planes;
+}
+
+
+// Largest difference of two rows, including the padding that neither may touch
+static real32 maxDifference(const std::vector<real32> &a, const std::vector<real32> &b) {
+    real32 difference = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::isnan(a[i]) != std::isnan(b[i])) return INFINITY;
+        if (!std::isnan(a[i])) difference = std::max(difference, std::fabs(a[i] - b[i]));
+    }
+    return difference;
+}
+
+
+typedef std::function<void(const real32*, const real32*, const real32*, real32*, real32*, real32*, uint32)> RGBKernel;
+
+static void compare(const std::string &name, const Planes &input, const RGBKernel &reference, const RGBKernel &kernel) {
+    real32 worst = 0.0f;
+    for (uint32 length = 0; length <= kLengths; length++) {
+        uint32 count = (length == kLengths) ? kLongLength : length;
+        for (uint32 offset = 0; offset < 2; offset++) {
+            Planes expected, actual;
+            for (Planes *planes : {&expected, &actual}) {
+                planes->r.assign(count + kPadding, -1234.0f);
+                planes->g.assign(count + kPadding, -1234.0f);
+                planes->b.assign(count + kPadding, -1234.0f);
+            }
+
+            reference(input.r.data() + offset, input.g.data() + offset, input.b.data() + offset,
+                      expected.r.data() + offset, expected.g.data() + offset, expected.b.data() + offset, count);
+            kernel(input.r.data() + offset, input.g.data() + offset, input.b.data() + offset,
+                   actual.r.data() + offset, actual.g.data() + offset, actual.b.data() + offset, count);
+
+            real32 difference = std::max(maxDifference(expected.r, actual.r),
+                                std::max(maxDifference(expected.g, actual.g), maxDifference(expected.b, actual.b)));
+            if (difference > kTolerance) {
+                failures++;
+                fprintf(stderr, "FAILED: %s, %u pixels at offset %u: difference %g\n", name.c_str(), count, offset, difference);
+            }
+            worst = std::max(worst, difference);
+        }
+    }
+    printf("%-40s max difference %g\n", name.c_str(), worst);
+}
+
+
+// Plane extraction has to match exactly. Only 4 -> 3 planes is vectorised, the other layouts
+// check that the kernels hand them to the reference.
+static void testExtractPlanes16(const std::string &prefix, const dng_suite &suite) {
+    static const uint32 layouts[][2] = {{4, 3}, {4, 4}, {3, 3}, {4, 1}, {1, 1}};
+
+    std::mt19937 random(4);
+    std::uniform_int_distribution<uint32> value(0, 0xFFFF);
+    std::vector<uint16> input;
+    for (uint32 i = 0; i < 4 * (kLongLength + kPadding); i++) {
+        // zeros and full-scale values among the random ones, in every plane
+        if (i % 7 == 3) input.push_back((i % 14 == 3) ? 0 : 0xFFFF);
+        else input.push_back(uint16(value(random)));
+    }
+
+    for (const auto &layout : layouts) {
+        uint32 sPlanes = layout[0], dPlanes = layout[1];
+        char name[64];
+        snprintf(name, sizeof(name), "%sExtractPlanes16 %u -> %u", prefix.c_str(), sPlanes, dPlanes);
+
+        bool failed = false;
+        for (uint32 length = 0; length <= kLengths; length++) {
+            uint32 count = (length == kLengths) ? kLongLength : length;
+            for (uint32 offset = 0; offset < 2; offset++) {
+                // the padding behind the row catches stores past its end
+                std::vector<uint16> expected(dPlanes * (count + kPadding), 0x1234), actual(expected);
+                RefExtractPlanes16(input.data() + offset * sPlanes, expected.data() + offset * dPlanes, count, sPlanes, dPlanes);
+                suite.ExtractPlanes16(input.data() + offset * sPlanes, actual.data() + offset * dPlanes, count, sPlanes, dPlanes);
+
+                if (expected != actual) {
+                    failures++;
+                    failed = true;
+                    fprintf(stderr, "FAILED: %s, %u pixels at offset %u\n", name, count, offset);
+                }
+            }
+        }
+        printf("%-40s %s\n", name, failed ? "differs" : "identical");
+    }
+}
+
+
+// Rendered float planes to 8-bit pixels, as Put does it: interleaved (vectorised) and planar
+// (reference). The input goes beyond both ends of 0..1 and has NaNs, and must match exactly.
+static void testCopyAreaR32_8(const std::string &prefix, const dng_suite &suite, const Planes &input) {
+    for (bool interleaved : {true, false}) {
+        std::string name = prefix + "CopyAreaR32_8 " + (interleaved ? "interleaved" : "planar");
+
+        bool failed = false;
+        for (uint32 length = 0; length <= kLengths; length++) {
+            uint32 count = (length == kLengths) ? kLongLength : length;
+            uint32 stride = count + kPadding;
+
+            // two rows of three planes, with negatives and NaNs among the values
+            std::vector<real32> source(2 * 3 * stride);
+            for (uint32 i = 0; i < source.size(); i++) {
+                uint32 planeIndex = (i / stride) % 3;
+                const std::vector<real32> &plane = (planeIndex == 0) ? input.r : ((planeIndex == 1) ? input.g : input.b);
+                source[i] = (i % 13 == 4) ? -plane[i % stride] : ((i % 29 == 7) ? NAN : plane[i % stride]);
+            }
+
+            int32 dColStep = interleaved ? 3 : 1, dPlaneStep = interleaved ? 1 : int32(stride);
+            std::vector<uint8> expected(2 * 3 * stride, 0x55), actual(expected);
+            for (uint32 pixelRange : {255u, 200u}) {
+                RefCopyAreaR32_8(source.data(), expected.data(), 2, count, 3, 3 * stride, 1, stride,
+                                 3 * stride, dColStep, dPlaneStep, pixelRange);
+                suite.CopyAreaR32_8(source.data(), actual.data(), 2, count, 3, 3 * stride, 1, stride,
+                                    3 * stride, dColStep, dPlaneStep, pixelRange);
+                if (expected != actual) {
+                    failures++;
+                    failed = true;
+                    fprintf(stderr, "FAILED: %s, %u pixels, range %u\n", name.c_str(), count, pixelRange);
+                }
+            }
+        }
+        printf("%-40s %s\n", name.c_str(), failed ? "differs" : "identical");
+    }
+}
+
+
+// Weights of bicubic downscaling with the given number of taps (twice the radius, from a scale of
+// 2 / radius); odd tap counts take the first taps of the next even count
+static const dng_resample_weights& resampleWeights(uint32 taps) {
+    static std::vector<std::unique_ptr<dng_resample_weights>> weights(64);
+    uint32 radius = (taps + 1) / 2;
+    if (!weights[radius]) {
+        weights[radius].reset(new dng_resample_weights);
+        weights[radius]->Initialize(2.0 / radius, dng_resample_bicubic::Get(), gDefaultDNGMemoryAllocator);
+    }
+    return *weights[radius];
+}
+
+
+// Samples with runs of 0 and 65535, where the sign offset and the bias of the 16-bit kernels
+// are at their limits, between random ones
+static std::vector<uint16> makeSamples16(uint32 count, uint32 seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<uint32> value(0, 0xFFFF);
+    std::vector<uint16> samples(count);
+    for (uint32 i = 0; i < count; i++) {
+        uint32 run = (i / 5) % 6;
+        samples[i] = (run == 1) ? 0 : ((run == 3) ? 0xFFFF : uint16(value(random)));
+    }
+    return samples;
+}
+
+
+// The resampling kernels have to match exactly, for every tap count up to 20 and one above 16
+// (vectorised taps of ResampleAcross16 with AVX2), both pixel ranges and fractional positions
+static void testResample(const std::string &prefix, const dng_suite &suite) {
+    static const uint32 tapCounts[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 36};
+    static const uint32 pixelRanges[] = {65535, 4095};
+
+    const uint32 rowStep = kLongLength + kPadding + 16;
+    std::vector<uint16> samples16 = makeSamples16(rowStep * 40, 5);
+    std::vector<real32> samples32(samples16.size());
+    for (size_t i = 0; i < samples16.size(); i++) samples32[i] = samples16[i] / 65535.0f;
+
+    bool failed16 = false, failed32 = false, failedAcross = false;
+    for (uint32 taps : tapCounts) {
+        const dng_resample_weights &weights = resampleWeights(taps);
+        for (uint32 fract : {0u, 37u, kResampleSubsampleCount / 2}) {
+            const int16 *w16 = weights.Weights16(fract);
+            const real32 *w32 = weights.Weights32(fract);
+
+            for (uint32 length = 0; length <= kLengths; length++) {
+                uint32 count = (length == kLengths) ? kLongLength : length;
+
+                for (uint32 pixelRange : pixelRanges) {
+                    std::vector<uint16> expected(count + kPadding, 0x1234), actual(expected);
+                    RefResampleDown16(samples16.data() + length, expected.data(), count, rowStep, w16, taps, pixelRange);
+                    suite.ResampleDown16(samples16.data() + length, actual.data(), count, rowStep, w16, taps, pixelRange);
+                    if (expected != actual) {
+                        failures++;
+                        failed16 = true;
+                        fprintf(stderr, "FAILED: %sResampleDown16, %u taps, %u pixels, range %u\n",
+                                prefix.c_str(), taps, count, pixelRange);
+                    }
+                }
+
+                // single tap rows are weighted like the last row (see RefResampleDown32), so both are read
+                std::vector<real32> expected(count + kPadding, -1234.0f), actual(expected);
+                RefResampleDown32(samples32.data() + length, expected.data(), count, rowStep, w32, taps);
+                suite.ResampleDown32(samples32.data() + length, actual.data(), count, rowStep, w32, taps);
+                if (expected != actual) {
+                    failures++;
+                    failed32 = true;
+                    fprintf(stderr, "FAILED: %sResampleDown32, %u taps, %u pixels\n", prefix.c_str(), taps, count);
+                }
+            }
+        }
+
+        // Destination pixels at a scale of about 1 / 1.7 with all fractional positions
+        for (uint32 length = 0; length <= kLengths; length++) {
+            uint32 count = (length == kLengths) ? 500 : length;
+            std::vector<int32> coord(count);
+            for (uint32 j = 0; j < count; j++) coord[j] = int32(j * 1.7 * kResampleSubsampleCount) + int32(j % 5);
+
+            for (uint32 pixelRange : pixelRanges) {
+                std::vector<uint16> expected(count + kPadding, 0x1234), actual(expected);
+                RefResampleAcross16(samples16.data() + length, expected.data(), count, coord.data(),
+                                    weights.Weights16(0), taps, weights.Step(), pixelRange);
+                suite.ResampleAcross16(samples16.data() + length, actual.data(), count, coord.data(),
+                                       weights.Weights16(0), taps, weights.Step(), pixelRange);
+                if (expected != actual) {
+                    failures++;
+                    failedAcross = true;
+                    fprintf(stderr, "FAILED: %sResampleAcross16, %u taps, %u pixels, range %u\n",
+                            prefix.c_str(), taps, count, pixelRange);
+                }
+            }
+        }
+    }
+    printf("%-40s %s\n", (prefix + "ResampleDown16").c_str(), failed16 ? "differs" : "identical");
+    printf("%-40s %s\n", (prefix + "ResampleDown32").c_str(), failed32 ? "differs" : "identical");
+    printf("%-40s %s\n", (prefix + "ResampleAcross16").c_str(), failedAcross ? "differs" : "identical");
+}
+
+
+static void testLevel(const char *level) {
+    dng_suite suite = dng_suite();
+    if (!SetSimdKernels(suite, level)) {
+        printf("%s: not supported, skipped\n", level);
+        return;
+    }
+    std::string prefix = std::string(level) + " ";
+
+    testExtractPlanes16(prefix, suite);
+    if (suite.BaselineABCtoRGB == NULL) return;  // sse2 only has plane extraction
+
+    Planes unitInput = makeInput(false, 1);
+    Planes overrangeInput = makeInput(true, 2);
+
+    dng_vector cameraWhite(3);
+    cameraWhite[0] = 1.0;
+    cameraWhite[1] = 0.8;
+    cameraWhite[2] = 0.9;
+    dng_matrix_3by3 cameraToRGB( 1.60, -0.40, -0.20,
+                                -0.30,  1.50, -0.20,
+                                 0.05, -0.50,  1.45);
+    dng_matrix_3by3 rgbToRGB( 1.20, -0.15, -0.05,
+                             -0.10,  1.15, -0.05,
+                             -0.02, -0.08,  1.10);
+
+    testCopyAreaR32_8(prefix, suite, overrangeInput);
+    testResample(prefix, suite);
+
+    compare(prefix + "BaselineABCtoRGB", overrangeInput,
+        [&](const real32 *a, const real32 *b, const real32 *c, real32 *r, real32 *g, real32 *bl, uint32 count) {
+            RefBaselineABCtoRGB(a, b, c, r, g, bl, count, cameraWhite, cameraToRGB);},
+        [&](const real32 *a, const real32 *b, const real32 *c, real32 *r, real32 *g, real32 *bl, uint32 count) {
+            suite.BaselineABCtoRGB(a, b, c, r, g, bl, count, cameraWhite, cameraToRGB);});
+
+    compare(prefix + "BaselineRGBtoRGB", overrangeInput,
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            RefBaselineRGBtoRGB(sr, sg, sb, r, g, b, count, rgbToRGB);},
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            suite.BaselineRGBtoRGB(sr, sg, sb, r, g, b, count, rgbToRGB);});
+
+    dng_1d_table gammaTable, toneTable, encodeTable, decodeTable;
+    gammaTable.Initialize(gDefaultDNGMemoryAllocator, PowerCurve(1.0 / 2.2));
+    toneTable.Initialize(gDefaultDNGMemoryAllocator, SCurve());
+    encodeTable.Initialize(gDefaultDNGMemoryAllocator, PowerCurve(1.0 / 2.4));
+    decodeTable.Initialize(gDefaultDNGMemoryAllocator, PowerCurve(2.4));
+
+    compare(prefix + "Baseline1DTable", unitInput,
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            RefBaseline1DTable(sr, r, count, gammaTable);
+            RefBaseline1DTable(sg, g, count, gammaTable);
+            RefBaseline1DTable(sb, b, count, gammaTable);},
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            suite.Baseline1DTable(sr, r, count, gammaTable);
+            suite.Baseline1DTable(sg, g, count, gammaTable);
+            suite.Baseline1DTable(sb, b, count, gammaTable);});
+
+    compare(prefix + "BaselineRGBTone", unitInput,
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            RefBaselineRGBTone(sr, sg, sb, r, g, b, count, toneTable);},
+        [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+            suite.BaselineRGBTone(sr, sg, sb, r, g, b, count, toneTable);});
+
+    // 2.5D and 3D maps, each with and without value encoding
+    std::mt19937 random(3);
+    std::uniform_real_distribution<real32> hueShift(-20.0f, 20.0f), scale(0.6f, 1.4f);
+    for (uint32 valDivisions : {1u, 6u}) {
+        dng_hue_sat_map map;
+        map.SetDivisions(36, 8, valDivisions);
+        for (uint32 v = 0; v < valDivisions; v++)
+            for (uint32 h = 0; h < 36; h++)
+                for (uint32 s = 0; s < 8; s++) {
+                    dng_hue_sat_map::HSBModify modify;
+                    modify.fHueShift = hueShift(random);
+                    modify.fSatScale = scale(random);
+                    modify.fValScale = scale(random);
+                    map.SetDelta(h, s, v, modify);
+                }
+
+        for (bool encoded : {false, true}) {
+            const dng_1d_table *encode = encoded ? &encodeTable : NULL;
+            const dng_1d_table *decode = encoded ? &decodeTable : NULL;
+            compare(prefix + "BaselineHueSatMap " + ((valDivisions == 1) ? "2.5D" : "3D") + (encoded ? " encoded" : ""), unitInput,
+                [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+                    RefBaselineHueSatMap(sr, sg, sb, r, g, b, count, map, encode, decode);},
+                [&](const real32 *sr, const real32 *sg, const real32 *sb, real32 *r, real32 *g, real32 *b, uint32 count) {
+                    suite.BaselineHueSatMap(sr, sg, sb, r, g, b, count, map, encode, decode);});
+        }
+    }
+}
+
+
+int main() {
+    for (const char *level : {"sse2", "sse4.1", "avx2"}) testLevel(level);
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all kernels match the reference\n");
+    return 0;
+}
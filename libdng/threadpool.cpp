@@ -0,0 +1,182 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "threadpool.h"
+
+#include "dng_assertions.h"
+#include "dng_exceptions.h"
+
+#include <memory>
+#include <algorithm>
+
+
+class ThreadPool::Job {
+public:
+    Job(uint32 slotCount, uint32 itemCount, const WorkFunction &work);
+
+    // Called with the pool mutex held
+    bool ClaimSlot(uint32 &slot);
+
+    // Processes items until there is nothing left to take or steal
+    void Participate(uint32 slot);
+
+    uint32 m_active;                 // workers (not the caller) currently in Participate, guarded by pool mutex
+    std::condition_variable m_done;
+
+private:
+    struct Range {
+        std::mutex mutex;
+        uint32 begin, end;
+    };
+
+    bool NextItem(uint32 slot, uint32 &item);
+
+    const WorkFunction &m_work;
+    const uint32 m_slotCount;
+    uint32 m_nextSlot;               // guarded by pool mutex
+    std::unique_ptr<Range[]> m_ranges;
+};
+
+
+ThreadPool::Job::Job(uint32 slotCount, uint32 itemCount, const WorkFunction &work) :
+    m_active(0), m_work(work), m_slotCount(slotCount), m_nextSlot(0), m_ranges(new Range[slotCount])
+{
+    // Start with an even, contiguous split - neighbouring tiles tend to stay on one thread
+    for (uint32 slot = 0; slot < slotCount; slot++) {
+        m_ranges[slot].begin = static_cast<uint32>((static_cast<uint64>(itemCount) * slot) / slotCount);
+        m_ranges[slot].end   = static_cast<uint32>((static_cast<uint64>(itemCount) * (slot + 1)) / slotCount);
+    }
+}
+
+
+bool ThreadPool::Job::ClaimSlot(uint32 &slot) {
+    if (m_nextSlot >= m_slotCount) return false;
+    slot = m_nextSlot++;
+    return true;
+}
+
+
+void ThreadPool::Job::Participate(uint32 slot) {
+    uint32 item;
+    while (NextItem(slot, item)) m_work(slot, item);
+}
+
+
+bool ThreadPool::Job::NextItem(uint32 slot, uint32 &item) {
+    Range &own = m_ranges[slot];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin < own.end) {item = own.begin++; return true;}
+    }
+
+    // Own range is empty: steal the back half of the largest remaining range
+    while (true) {
+        uint32 victim = m_slotCount, victimSize = 0;
+        for (uint32 other = 0; other < m_slotCount; other++) {
+            if (other == slot) continue;
+            std::lock_guard<std::mutex> lock(m_ranges[other].mutex);
+            uint32 size = m_ranges[other].end - m_ranges[other].begin;
+            if (size > victimSize) {victim = other; victimSize = size;}
+        }
+        if (victim == m_slotCount) return false;
+
+        uint32 stolenBegin, stolenEnd;
+        {
+            std::lock_guard<std::mutex> lock(m_ranges[victim].mutex);
+            uint32 size = m_ranges[victim].end - m_ranges[victim].begin;
+            if (size == 0) continue;
+            stolenEnd = m_ranges[victim].end;
+            stolenBegin = stolenEnd - (size + 1) / 2;
+            m_ranges[victim].end = stolenBegin;
+        }
+
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = stolenBegin + 1;
+        own.end = stolenEnd;
+        item = stolenBegin;
+        return true;
+    }
+}
+
+
+ThreadPool::ThreadPool(uint32 workerCount) : m_shutdown(false) {
+    for (uint32 i = 0; i < workerCount; i++) m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& worker : m_workers) worker.join();
+}
+
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool sharedPool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return sharedPool;
+}
+
+
+void ThreadPool::Run(uint32 slotCount, uint32 itemCount, const WorkFunction &work) {
+    if (itemCount == 0) return;
+    slotCount = std::max(1u, std::min(slotCount, itemCount));
+
+    Job job(slotCount, itemCount, work);
+    uint32 slot = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool claimed = job.ClaimSlot(slot);  // nobody else knows the job yet
+        DNG_REQUIRE(claimed, "ThreadPool: caller could not claim the first slot of its own job");
+        if (slotCount > 1 && !m_workers.empty()) m_jobs.push_back(&job);
+    }
+    if (slotCount > 1) m_wakeup.notify_all();
+
+    // The caller always works on its own job, so it completes even if all workers are busy elsewhere
+    job.Participate(slot);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobs.remove(&job);
+    job.m_done.wait(lock, [&job]{return job.m_active == 0;});
+}
+
+
+void ThreadPool::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        Job *job = NULL;
+        uint32 slot = 0;
+        for (auto candidate : m_jobs)
+            if (candidate->ClaimSlot(slot)) {job = candidate; break;}
+
+        if (job == NULL) {
+            if (m_shutdown) return;
+            m_wakeup.wait(lock);
+            continue;
+        }
+
+        job->m_active++;
+        lock.unlock();
+        job->Participate(slot);
+        lock.lock();
+        if (--job->m_active == 0) job->m_done.notify_all();
+    }
+}
@@ -0,0 +1,69 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include "dng_types.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <list>
+
+/*
+  Persistent pool of worker threads for tile-based work.
+
+  Run() splits a number of work items over a number of slots. Each slot starts
+  out owning a contiguous range of items; a slot that runs out steals half of
+  the largest remaining range of another slot, so uneven items balance out.
+  The calling thread always works on its own job, which means several jobs
+  (also nested ones) can run at the same time without starving each other.
+*/
+class ThreadPool {
+public:
+    typedef std::function<void(uint32 slot, uint32 item)> WorkFunction;
+
+    explicit ThreadPool(uint32 workerCount);
+    ~ThreadPool();
+
+    uint32 WorkerCount() const {return static_cast<uint32>(m_workers.size());}
+
+    // Calls work(slot, item) for every item in [0, itemCount), with slot < slotCount and
+    // no two concurrent calls sharing a slot. Returns once all items are done. work must not throw.
+    void Run(uint32 slotCount, uint32 itemCount, const WorkFunction &work);
+
+    // Process-wide pool, created on first use with one worker less than hardware concurrency
+    static ThreadPool& Shared();
+
+private:
+    class Job;
+
+    void WorkerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::list<Job*> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_shutdown;
+
+    // Hidden copy constructor and assignment operator
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
@@ -7,3 +7,5 @@
 #define RAW2DNG_VERSION_MAKE(a,b,c) #a"."#b"."#c
 #define _RAW2DNG_VERSION_MAKE(a,b,c) RAW2DNG_VERSION_MAKE(a,b,c)
 #define RAW2DNG_VERSION_STR _RAW2DNG_VERSION_MAKE(RAW2DNG_VERSION_MAJOR,RAW2DNG_VERSION_MINOR,RAW2DNG_VERSION_PATCH)
+
+#cmakedefine RAW2DNG_USE_LIBDEFLATE
@@ -28,11 +28,11 @@
 #include <exiv2/image.hpp>
 
 
-DNGprocessor::DNGprocessor(AutoPtr<dng_host> &host, std::string filename)
-                             : NegativeProcessor(host, filename) {
+DNGprocessor::DNGprocessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream)
+                             : NegativeProcessor(host, filename, inputStream) {
     // Re-read source DNG using DNG SDK - we're ignoring the LibRaw/Exiv2 data structures from now on
     try {
-        dng_file_stream stream(m_inputFileName.c_str());
+        dng_stream &stream = *m_inputStream;
 
         dng_info info;
         info.Parse(*(m_host.Get()), stream);
@@ -62,7 +62,7 @@ void DNGprocessor::setCameraProfile(const char *dcpFilename) {
     AutoPtr<dng_camera_profile> prof(new dng_camera_profile);
 
     if (strlen(dcpFilename) > 0) {
-        dng_file_stream profStream(dcpFilename);
+        MmapStream profStream(dcpFilename);
         if (!prof->ParseExtended(profStream))
             throw std::runtime_error("Could not parse supplied camera prom_inputFileName m_inputFileName!");
         m_negative->AddProfile(prof);
@@ -45,5 +45,5 @@ public:
    void buildDNGImage() override;
 
 protected:
-   DNGprocessor(AutoPtr<dng_host> &host, std::string filename);
+   DNGprocessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream);
 };
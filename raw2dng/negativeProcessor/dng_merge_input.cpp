@@ -9,22 +9,10 @@
 
 #include <exiv2/image.hpp>
 
-DNGMergeProcessor::DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filename, std::string& greenFilename, std::string& blueFilename)
-                             : DNGprocessor(host, filename) {
-    // Re-read source DNG using DNG SDK - we're ignoring the LibRaw/Exiv2 data structures from now on
+DNGMergeProcessor::DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, std::string& greenFilename, std::string& blueFilename)
+                             : DNGprocessor(host, filename, inputStream) {
+    // DNGprocessor has read (and validated) the stage 1 image already, we only replace channels in it
     try {
-        dng_file_stream stream(m_inputFileName.c_str());
-
-        dng_info info;
-        info.Parse(*(m_host.Get()), stream);
-        info.PostParse(*(m_host.Get()));
-        if (!info.IsValidDNG()) throw dng_exception(dng_error_bad_format);
-
-        m_negative->Parse(*(m_host.Get()), stream, info);
-        m_negative->PostParse(*(m_host.Get()), stream, info);
-
-        m_negative->ReadStage1Image(*(m_host.Get()), stream, info);
-
         const dng_image* rawImage = m_negative->Stage1Image();
 
         std::vector<unsigned char> buf(rawImage->Width() * rawImage->Height() * rawImage->PixelSize());
@@ -52,10 +40,6 @@ DNGMergeProcessor::DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filena
         AutoPtr<dng_image> dstImage ((*host.Get()).Make_dng_image(rawImage->Bounds(), rawImage->Planes(), rawImage->PixelType()));
         dstImage->Put(buffer);
         m_negative->SetStage1Image(dstImage);
-
-
-        m_negative->ReadTransparencyMask(*(m_host.Get()), stream, info);
-        m_negative->ValidateRawImageDigest(*(m_host.Get()));
     }
     catch (const dng_exception &except) {throw except;}
     catch (...) {throw dng_exception(dng_error_unknown);}
@@ -64,7 +48,7 @@ DNGMergeProcessor::DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filena
 void DNGMergeProcessor::replaceChannelWithFile(dng_pixel_buffer& destBuffer, std::string& filename, ColorKeyCode color) {
     try {
         AutoPtr<dng_negative> negative(m_host->Make_dng_negative());
-        dng_file_stream stream(filename.c_str());
+        MmapStream stream(filename.c_str());
         dng_info info;
         info.Parse(*(m_host.Get()), stream);
         info.PostParse(*(m_host.Get()));
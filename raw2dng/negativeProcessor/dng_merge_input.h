@@ -8,6 +8,6 @@ friend class NegativeProcessor;
 public:
 
 protected:
-    DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filename, std::string& greenFilename, std::string& blueFilename);
+    DNGMergeProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, std::string& greenFilename, std::string& blueFilename);
     void replaceChannelWithFile(dng_pixel_buffer& destBuffer, std::string& filename, ColorKeyCode color);
 };
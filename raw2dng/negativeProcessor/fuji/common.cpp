@@ -29,8 +29,8 @@
 
 // TODO/FIXME: Fuji support is currently broken!
 
-FujiProcessor::FujiProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
-    VendorRawProcessor(host, filename, inputImage, rawProcessor)
+FujiProcessor::FujiProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
+    VendorRawProcessor(host, filename, inputStream, inputImage, rawProcessor)
 {
     m_fujiRotate90 = (2 == m_RawProcessor->COLOR(0, 1)) && (1 == m_RawProcessor->COLOR(1, 0));
 }
@@ -31,7 +31,7 @@ public:
    void buildDNGImage();
 
 protected:
-   FujiProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
+   FujiProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
 
    bool m_fujiRotate90;
 };
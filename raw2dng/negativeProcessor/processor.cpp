@@ -29,14 +29,27 @@
 #include "variousVendorProcessor.h"
 
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include <dng_simple_image.h>
+#include <dng_area_task.h>
 #include <dng_camera_profile.h>
 #include <dng_file_stream.h>
+#include <dng_fingerprint.h>
 #include <dng_memory_stream.h>
+#include <dng_tag_codes.h>
+#include <dng_tag_values.h>
 #include <dng_xmp.h>
 
+#include "config.h"
+
+#ifdef RAW2DNG_USE_LIBDEFLATE
+#include <libdeflate.h>
+#else
 #include <zlib.h>
+#endif
 
 #include <exiv2/xmp.hpp>
 #include <libraw/libraw.h>
@@ -62,16 +75,37 @@ const char* getDngErrorMessage(int errorCode) {
 }
 
 
-NegativeProcessor::NegativeProcessor(AutoPtr<dng_host> &host, std::string filename):
+NegativeProcessor::NegativeProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream):
     m_host(host),
+    m_inputStream(inputStream),
     m_inputFileName(filename)
 {
     m_negative.Reset(m_host->Make_dng_negative());
 }
 
 
+MmapStream* openInputFile(const std::string &filename) {
+    try {return new MmapStream(filename.c_str());}
+    catch (dng_exception &e) {
+        std::stringstream error; error << "Cannot read input file " << filename << " (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
+        throw std::runtime_error(error.str());
+    }
+}
+
+
+NegativeProcessor* NegativeProcessor::createDNGProcessor(AutoPtr<dng_host> &host, std::string& filename, MmapStream *inputStream) {
+    try {return new DNGprocessor(host, filename, inputStream);}
+    catch (dng_exception &e) {
+        std::stringstream error; error << "Cannot parse source DNG-file (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
+        throw std::runtime_error(error.str());
+    }
+}
+
+
 NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, std::string& filename, std::string& jpgFilename)
 {
+    AutoPtr<MmapStream> inputStream(openInputFile(filename));
+
     Exiv2::Image::AutoPtr inputImage;
     try {
         inputImage = Exiv2::ImageFactory::open(jpgFilename);
@@ -82,13 +116,15 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, s
         throw std::runtime_error(error.str());
     }
 
-    return new XiaomiYiProcessor(host, filename, inputImage);
+    return new XiaomiYiProcessor(host, filename, inputStream.Release(), inputImage);
 }
 
 NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, std::string& filename, std::string& greenFilename, std::string& blueFilename)
 {
+    AutoPtr<MmapStream> inputStream(openInputFile(filename));
+
     try {
-        return new DNGMergeProcessor(host, filename, greenFilename, blueFilename);
+        return new DNGMergeProcessor(host, filename, inputStream.Release(), greenFilename, blueFilename);
     }
     catch (dng_exception &e) {
         std::stringstream error; error << "Cannot parse source DNG-file (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
@@ -97,17 +133,52 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, s
 }
 
 
+// Cheap check for a DNG: a TIFF file with the DNGVersion tag in IFD 0 (required by the spec)
+bool isDNG(dng_stream &stream) {
+    try {
+        stream.SetReadPosition(0);
+        uint16 byteOrder = stream.Get_uint16();
+        if (byteOrder == byteOrderII) stream.SetLittleEndian();
+        else if (byteOrder == byteOrderMM) stream.SetBigEndian();
+        else return false;
+        if (stream.Get_uint16() != 42) return false;
+
+        stream.SetReadPosition(stream.Get_uint32());
+        uint32 entryCount = stream.Get_uint16();
+        for (uint32 entry = 0; entry < entryCount; entry++) {
+            if (stream.Get_uint16() == tcDNGVersion) return true;
+            stream.Skip(10);
+        }
+    }
+    catch (const dng_exception&) {}  // truncated - whatever it is, it isn't a valid DNG
+
+    return false;
+}
+
+
 NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, std::string& filename) {
+    // Map the file once, all parsers work on the same memory
+    AutoPtr<MmapStream> inputStream(openInputFile(filename));
+
+    // DNGs are read by the DNG SDK alone, don't decode or parse them with LibRaw/Exiv2 first
+    if (isDNG(*inputStream)) return createDNGProcessor(host, filename, inputStream.Release());
+
     // Open and parse rawfile with libraw...
     AutoPtr<LibRaw> rawProcessor(new LibRaw());
 
-    int ret = rawProcessor->open_file(filename.c_str());
+    int ret = rawProcessor->open_buffer(const_cast<uint8*>(inputStream->Data()), inputStream->Size());
     if (ret != LIBRAW_SUCCESS) {
         rawProcessor->recycle();
         std::stringstream error; error << "LibRaw-error while opening rawFile: " << libraw_strerror(ret);
         throw std::runtime_error(error.str());
     }
 
+    // LibRaw might still identify a DNG that the header check missed - not worth unpacking either
+    if (rawProcessor->imgdata.idata.dng_version != 0) {
+        rawProcessor->recycle();
+        return createDNGProcessor(host, filename, inputStream.Release());
+    }
+
     ret = rawProcessor->unpack();
     if (ret != LIBRAW_SUCCESS) {
         rawProcessor->recycle();
@@ -118,7 +189,7 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, s
     // ...and libexiv2
     Exiv2::Image::AutoPtr rawImage;
     try {
-        rawImage = Exiv2::ImageFactory::open(filename);
+        rawImage = Exiv2::ImageFactory::open(inputStream->Data(), static_cast<long>(inputStream->Size()));
         rawImage->readMetadata();
     } 
     catch (Exiv2::Error& e) {
@@ -127,90 +198,178 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, s
     }
 
     // Identify and create correct processor class
-    if (rawProcessor->imgdata.idata.dng_version != 0) {
-        try {return new DNGprocessor(host, filename);}
-        catch (dng_exception &e) {
-            std::stringstream error; error << "Cannot parse source DNG-file (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
-            throw std::runtime_error(error.str());
+    if (!strcmp(rawProcessor->imgdata.idata.model, "ILCE-7"))
+        return new ILCE7processor(host, filename, inputStream.Release(), rawImage, rawProcessor.Release());
+    else if (!strcmp(rawProcessor->imgdata.idata.make, "FUJIFILM"))
+        return new FujiProcessor(host, filename, inputStream.Release(), rawImage, rawProcessor.Release());
+
+    return new VariousVendorProcessor(host, filename, inputStream.Release(), rawImage, rawProcessor.Release());
+}
+
+
+// Compresses the 64k blocks of the original file, each into its own zlib stream (as per spec).
+// The area is one column with a row per block, so blocks are spread over the threads one by one.
+// Built with RAW2DNG_USE_LIBDEFLATE, libdeflate produces the zlib streams instead of zlib.
+class DeflateBlocksTask : public dng_area_task {
+public:
+    static const uint32 kBlockSize = 65536;
+
+    DeflateBlocksTask(const uint8 *data, uint64 size, int level, uint8 *output, uint32 outputStride, uint32 *outputLengths) :
+        m_data(data), m_size(size), m_level(level), m_output(output), m_outputStride(outputStride), m_outputLengths(outputLengths)
+    {
+        fMaxTileSize = dng_point(1, 1);
+    }
+
+#ifdef RAW2DNG_USE_LIBDEFLATE
+    ~DeflateBlocksTask() {
+        for (auto compressor : m_compressors) libdeflate_free_compressor(compressor);
+    }
+
+    // Space needed for one compressed block
+    static uint32 OutputStride(int level) {
+        libdeflate_compressor *compressor = libdeflate_alloc_compressor(level);
+        if (compressor == NULL) throw std::runtime_error("Error initialising libdeflate for embedding raw file!");
+        size_t bound = libdeflate_zlib_compress_bound(compressor, kBlockSize);
+        libdeflate_free_compressor(compressor);
+        return static_cast<uint32>(bound);
+    }
+
+    virtual void Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer *sniffer) {
+        m_compressors.resize(threadCount, NULL);
+        for (auto &compressor : m_compressors) {
+            compressor = libdeflate_alloc_compressor(m_level);
+            if (compressor == NULL) throw std::runtime_error("Error initialising libdeflate for embedding raw file!");
         }
     }
-    else if (!strcmp(rawProcessor->imgdata.idata.model, "ILCE-7"))
-        return new ILCE7processor(host, filename, rawImage, rawProcessor.Release());
-    else if (!strcmp(rawProcessor->imgdata.idata.make, "FUJIFILM"))
-        return new FujiProcessor(host, filename, rawImage, rawProcessor.Release());
 
-    return new VariousVendorProcessor(host, filename, rawImage, rawProcessor.Release());
+    virtual void Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer *sniffer) {
+        for (int32 block = tile.t; block < tile.b; block++) {
+            uint64 offset = static_cast<uint64>(block) * kBlockSize;
+            size_t length = libdeflate_zlib_compress(m_compressors[threadIndex], m_data + offset,
+                                                     static_cast<size_t>(std::min(static_cast<uint64>(kBlockSize), m_size - offset)),
+                                                     m_output + static_cast<uint64>(block) * m_outputStride, m_outputStride);
+            if (length == 0) throw std::runtime_error("Error compressing chunk for embedding raw file!");
+            m_outputLengths[block] = static_cast<uint32>(length);
+        }
+    }
+#else
+    ~DeflateBlocksTask() {
+        for (auto &stream : m_streams) deflateEnd(&stream);
+    }
+
+    // Space needed for one compressed block
+    static uint32 OutputStride(int level) {return static_cast<uint32>(compressBound(kBlockSize));}
+
+    // deflateInit allocates a few hundred kB - set up one stream per thread and reset it per block
+    virtual void Start(uint32 threadCount, const dng_point &tileSize, dng_memory_allocator *allocator, dng_abort_sniffer *sniffer) {
+        // zlib keeps a pointer to the z_stream, so initialise them in place (zeroed, deflateEnd is safe on unused ones)
+        m_streams.resize(threadCount);
+        for (auto &zstrm : m_streams) {
+            if (deflateInit(&zstrm, m_level) != Z_OK)
+                throw std::runtime_error("Error initialising ZLib for embedding raw file!");
+        }
+    }
+
+    virtual void Process(uint32 threadIndex, const dng_rect &tile, dng_abort_sniffer *sniffer) {
+        z_stream &zstrm = m_streams[threadIndex];
+        for (int32 block = tile.t; block < tile.b; block++) {
+            uint64 offset = static_cast<uint64>(block) * kBlockSize;
+            deflateReset(&zstrm);
+            zstrm.avail_in = static_cast<uInt>(std::min(static_cast<uint64>(kBlockSize), m_size - offset));
+            zstrm.next_in = const_cast<Bytef*>(m_data + offset);
+            zstrm.avail_out = m_outputStride;
+            zstrm.next_out = m_output + static_cast<uint64>(block) * m_outputStride;
+            if (deflate(&zstrm, Z_FINISH) != Z_STREAM_END)
+                throw std::runtime_error("Error compressing chunk for embedding raw file!");
+            m_outputLengths[block] = static_cast<uint32>(zstrm.total_out);
+        }
+    }
+#endif
+
+private:
+    const uint8 *m_data;
+    uint64 m_size;
+    int m_level;
+    uint8 *m_output;
+    uint32 m_outputStride;
+    uint32 *m_outputLengths;
+#ifdef RAW2DNG_USE_LIBDEFLATE
+    std::vector<libdeflate_compressor*> m_compressors;
+#else
+    std::vector<z_stream> m_streams;
+#endif
+};
+
+
+// Writes a big-endian uint32 (as OriginalRawFileData is big-endian)
+void putBigEndian32(uint8 *buffer, uint32 value) {
+    buffer[0] = static_cast<uint8>(value >> 24);
+    buffer[1] = static_cast<uint8>(value >> 16);
+    buffer[2] = static_cast<uint8>(value >>  8);
+    buffer[3] = static_cast<uint8>(value);
 }
 
 
-void NegativeProcessor::embedOriginalFile(const char *rawFilename) {
-    #define BLOCKSIZE 65536 // as per spec
+dng_memory_block* NegativeProcessor::compressOriginalFile(dng_host &host, const uint8 *data, uint64 size, int compressionLevel,
+                                                          dng_fingerprint &digest) {
+    if (compressionLevel < 1 || compressionLevel > 9)
+        throw std::runtime_error("Compression level for embedding raw file must be between 1 and 9!");
+
+    const uint32 numberRawBlocks = static_cast<uint32>((size + DeflateBlocksTask::kBlockSize - 1) / DeflateBlocksTask::kBlockSize);
+
+    // Compress all blocks in parallel, each into its own slot of a scratch buffer
+    const uint32 outputStride = DeflateBlocksTask::OutputStride(compressionLevel);
+    if (size > 0xFFFFFFFF || static_cast<uint64>(numberRawBlocks) * outputStride > 0xFFFFFFFF)
+        throw std::runtime_error("Raw file is too large for embedding!");
+    AutoPtr<dng_memory_block> compressed(host.Allocate(std::max(numberRawBlocks, 1u) * outputStride));
+    std::vector<uint32> compressedLengths(numberRawBlocks);
+
+    if (numberRawBlocks > 0) {
+        DeflateBlocksTask task(data, size, compressionLevel, compressed->Buffer_uint8(), outputStride, compressedLengths.data());
+        host.PerformAreaTask(task, dng_rect(numberRawBlocks, 1));
+    }
 
-    // Open input/output streams and write header with empty indices
-    dng_file_stream rawDataStream(rawFilename);
-    rawDataStream.SetReadPosition(0);
+    // Assemble in index order: size, block offsets, offset of the end of data, blocks, and 7 empty
+    // "Mac OS forks" as per spec. The digest (MD5 of all of it) is built along the way.
+    uint32 indexLength = (1 + numberRawBlocks + 1) * sizeof(uint32);
+    uint64 totalLength = indexLength + 7 * sizeof(uint32);
+    for (auto length : compressedLengths) totalLength += length;
+    if (totalLength > 0xFFFFFFFF) throw std::runtime_error("Raw file is too large for embedding!");
 
-    uint32 rawFileSize = static_cast<uint32>(rawDataStream.Length());
-    uint32 numberRawBlocks = static_cast<uint32>(floor((rawFileSize + 65535.0) / 65536.0));
+    AutoPtr<dng_memory_block> embeddedRaw(host.Allocate(static_cast<uint32>(totalLength)));
+    uint8 *output = embeddedRaw->Buffer_uint8();
 
-    dng_memory_stream embeddedRawStream(m_host->Allocator());
-    embeddedRawStream.SetBigEndian(true);
-    embeddedRawStream.Put_uint32(rawFileSize);
-    for (uint32 block = 0; block < numberRawBlocks; block++) 
-        embeddedRawStream.Put_uint32(0);  // indices for the block-offsets
-    embeddedRawStream.Put_uint32(0);  // index to next data fork
+    putBigEndian32(output, static_cast<uint32>(size));
+    uint32 dataOffset = indexLength;
+    for (uint32 block = 0; block < numberRawBlocks; block++) {
+        putBigEndian32(output + (1 + block) * sizeof(uint32), dataOffset);
+        dataOffset += compressedLengths[block];
+    }
+    putBigEndian32(output + (1 + numberRawBlocks) * sizeof(uint32), dataOffset);
 
-    uint32 indexOffset = 1 * sizeof(uint32);
-    uint32 dataOffset = (numberRawBlocks + 1 + 1) * sizeof(uint32);
+    dng_md5_printer printer;
+    printer.Process(output, indexLength);
 
+    dataOffset = indexLength;
     for (uint32 block = 0; block < numberRawBlocks; block++) {
+        memcpy(output + dataOffset, compressed->Buffer_uint8() + static_cast<uint64>(block) * outputStride, compressedLengths[block]);
+        printer.Process(output + dataOffset, compressedLengths[block]);
+        dataOffset += compressedLengths[block];
+    }
+    compressed.Reset();
+
+    memset(output + dataOffset, 0, 7 * sizeof(uint32));
+    printer.Process(output + dataOffset, 7 * sizeof(uint32));
+
+    digest = printer.Result();
+    return embeddedRaw.Release();
+}
+
 
-        // Read and compress one 64k block of data
-        z_stream zstrm;
-        zstrm.zalloc = Z_NULL;
-        zstrm.zfree = Z_NULL;
-        zstrm.opaque = Z_NULL;
-        if (deflateInit(&zstrm, Z_DEFAULT_COMPRESSION) != Z_OK) 
-            throw std::runtime_error("Error initialising ZLib for embedding raw file!");
-
-        unsigned char inBuffer[BLOCKSIZE], outBuffer[BLOCKSIZE * 2];
-        uint32 currentRawBlockLength = 
-            static_cast<uint32>(std::min(static_cast<uint64>(BLOCKSIZE), rawFileSize - rawDataStream.Position()));
-        rawDataStream.Get(inBuffer, currentRawBlockLength);
-        zstrm.avail_in = currentRawBlockLength;
-        zstrm.next_in = inBuffer;
-        zstrm.avail_out = BLOCKSIZE * 2;
-        zstrm.next_out = outBuffer;
-        if (deflate(&zstrm, Z_FINISH) != Z_STREAM_END)
-            throw std::runtime_error("Error compressing chunk for embedding raw file!");
-
-        uint32 compressedBlockLength = zstrm.total_out;
-        deflateEnd(&zstrm);
-
-        // Write index and data
-        embeddedRawStream.SetWritePosition(indexOffset);
-        embeddedRawStream.Put_uint32(dataOffset);
-        indexOffset += sizeof(uint32);
-
-        embeddedRawStream.SetWritePosition(dataOffset);
-        embeddedRawStream.Put(outBuffer, compressedBlockLength);
-        dataOffset += compressedBlockLength;
-    }
-
-    embeddedRawStream.SetWritePosition(indexOffset);
-    embeddedRawStream.Put_uint32(dataOffset);
-
-    // Write 7 "Mac OS forks" as per spec - empty for us
-    embeddedRawStream.SetWritePosition(dataOffset);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-    embeddedRawStream.Put_uint32(0);
-
-    AutoPtr<dng_memory_block> block(embeddedRawStream.AsMemoryBlock(m_host->Allocator()));
+void NegativeProcessor::embedOriginalFile(int compressionLevel) {
+    // the input file is still mapped from parsing, so it is read just once more (for compressing)
+    dng_fingerprint digest;
+    AutoPtr<dng_memory_block> block(compressOriginalFile(*m_host, m_inputStream->Data(), m_inputStream->Size(), compressionLevel, digest));
     m_negative->SetOriginalRawFileData(block);
-    m_negative->FindOriginalRawFileDigest();
+    m_negative->SetOriginalRawFileDigest(digest);
 }
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include "mmapstream.h"
+
 #include <dng_host.h>
 #include <dng_negative.h>
 #include <dng_exif.h>
@@ -29,13 +31,14 @@
 class LibRaw;
 
 const char* getDngErrorMessage(int errorCode);
+MmapStream* openInputFile(const std::string &filename);
 
 class NegativeProcessor {
 public:
    static NegativeProcessor* createProcessor(AutoPtr<dng_host> &host, std::string& filename);
    static NegativeProcessor* createProcessor(AutoPtr<dng_host> &host, std::string& filename, std::string& jpgFilename);
    static NegativeProcessor* createProcessor(AutoPtr<dng_host> &host, std::string& filename, std::string& greenFilename, std::string& blueFilename);
-   //virtual ~NegativeProcessor();
+   virtual ~NegativeProcessor() {}
 
    dng_negative* getNegative() {return m_negative.Get();}
 
@@ -46,15 +49,33 @@ public:
    virtual void setXmpFromInput(const dng_date_time_info &dateTimeNow, const dng_string &appNameVersion) = 0;
    virtual void backupProprietaryData() = 0;
    virtual void buildDNGImage() = 0;
-   virtual void embedOriginalFile(const char *rawFilename);
+   // Embeds the input file as read for parsing, compressionLevel is the deflate level, from 1 (fastest) to 9 (smallest)
+   virtual void embedOriginalFile(int compressionLevel = kDefaultCompressionLevel);
+
+   // Compresses a file into the format of OriginalRawFileData: independently deflated 64k blocks.
+   // digest is set to the OriginalRawFileDigest of the result.
+   static dng_memory_block* compressOriginalFile(dng_host &host, const uint8 *data, uint64 size, int compressionLevel,
+                                                 dng_fingerprint &digest);
+
+   static const int kDefaultCompressionLevel = 6;
+
+   // Frees the input's image data that the negative doesn't reference anymore (i.e. once
+   // stage 2 was built). Metadata of the input must not be accessed afterwards.
+   virtual void releaseRawData() {}
 
 protected:
-   NegativeProcessor(AutoPtr<dng_host> &host, std::string filename);
+   static NegativeProcessor* createDNGProcessor(AutoPtr<dng_host> &host, std::string& filename, MmapStream *inputStream);
+
+   NegativeProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream);
    // Overloaded builder method to be used with Xiaomi Yi files
    NegativeProcessor(AutoPtr<dng_host> &host, std::string filename, std::string jpgFilename);
 
-   // Target: DNG-file
    AutoPtr<dng_host> &m_host;
+
+   // Source: input file, mapped once and shared by all parsers (LibRaw, Exiv2, DNG SDK)
+   AutoPtr<MmapStream> m_inputStream;
+
+   // Target: DNG-file
    AutoPtr<dng_negative> m_negative;
    std::string m_inputFileName;
 };
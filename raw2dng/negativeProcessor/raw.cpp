@@ -5,6 +5,7 @@
 #include "sony/ILCE7.h"
 #include "fuji/common.h"
 #include "variousVendorProcessor.h"
+#include "cowimage.h"
 
 #include <stdexcept>
 
@@ -20,7 +21,7 @@
 #include <libraw/libraw.h>
 
 
-RawProcessor::RawProcessor(AutoPtr<dng_host> &host, std::string filename) : NegativeProcessor(host, filename) {}
+RawProcessor::RawProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream) : NegativeProcessor(host, filename, inputStream) {}
 
 
 ColorKeyCode colorKey(const char color) {
@@ -139,7 +140,7 @@ void RawProcessor::setCameraProfile(const char *dcpFilename) {
     AutoPtr<dng_camera_profile> prof(new dng_camera_profile);
 
     if (strlen(dcpFilename) > 0) {
-        dng_file_stream profStream(dcpFilename);
+        MmapStream profStream(dcpFilename);
         if (!prof->ParseExtended(profStream))
             throw std::runtime_error("Could not parse supplied camera profile file!");
     }
@@ -438,7 +439,7 @@ void RawProcessor::buildDNGImage() {
 
     // Create new dng_image and copy data
     dng_rect bounds = dng_rect(sizes->raw_height, sizes->raw_width);
-    dng_simple_image *image = new dng_simple_image(bounds, outputPlanes, ttShort, m_host->Allocator());
+    CowImage *image = new CowImage(bounds, outputPlanes, ttShort, m_host->Allocator());
 
     dng_pixel_buffer buffer; image->GetPixelBuffer(buffer);
     unsigned short *imageBuffer = (unsigned short*)buffer.fData;
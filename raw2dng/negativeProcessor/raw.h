@@ -41,7 +41,7 @@ public:
    virtual void buildDNGImage() override;
 
 protected:
-   RawProcessor(AutoPtr<dng_host> &host, std::string filename);
+   RawProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream);
 
    virtual dng_memory_stream* createDNGPrivateTag();
 
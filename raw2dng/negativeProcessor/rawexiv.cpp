@@ -22,8 +22,8 @@
 #include <libraw/libraw.h>
 
 
-RawExiv2Processor::RawExiv2Processor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage):
-    RawProcessor(host, filename),
+RawExiv2Processor::RawExiv2Processor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage):
+    RawProcessor(host, filename, inputStream),
     m_InputImage(inputImage),
     m_InputExif(m_InputImage->exifData()),
     m_InputXmp(m_InputImage->xmpData())
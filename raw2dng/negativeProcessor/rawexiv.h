@@ -26,7 +26,7 @@
 */
 class RawExiv2Processor : public RawProcessor {
 protected:
-   RawExiv2Processor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &rawImage);
+   RawExiv2Processor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &rawImage);
 
    void setXmpFromInput(const dng_date_time_info &dateTimeNow, const dng_string &appNameVersion) override;
 
@@ -160,8 +160,8 @@ public:
 };
 
 
-ILCE7processor::ILCE7processor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
-    VendorRawProcessor(host, filename, inputImage, rawProcessor)
+ILCE7processor::ILCE7processor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
+    VendorRawProcessor(host, filename, inputStream, inputImage, rawProcessor)
 {}
 
 
@@ -30,7 +30,7 @@ public:
     void setXmpFromInput(const dng_date_time_info &dateTimeNow, const dng_string &appNameVersion);
 
 protected:
-    ILCE7processor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
+    ILCE7processor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
 
     dng_memory_stream* createDNGPrivateTag();
 };
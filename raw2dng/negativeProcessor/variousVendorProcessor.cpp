@@ -29,8 +29,8 @@
 #include "variousVendorProcessor.h"
 
 
-VariousVendorProcessor::VariousVendorProcessor(AutoPtr<dng_host> &host,std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
-    VendorRawProcessor(host, filename, inputImage, rawProcessor)
+VariousVendorProcessor::VariousVendorProcessor(AutoPtr<dng_host> &host,std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
+    VendorRawProcessor(host, filename, inputStream, inputImage, rawProcessor)
 {}
 
 
@@ -29,5 +29,5 @@ public:
     virtual void setExifFromInput(const dng_date_time_info &dateTimeNow, const dng_string &appNameVersion) override;
 
 protected:
-    VariousVendorProcessor(AutoPtr<dng_host> &host,std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
+    VariousVendorProcessor(AutoPtr<dng_host> &host,std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
 };
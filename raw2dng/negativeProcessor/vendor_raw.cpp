@@ -22,9 +22,12 @@
 
 
 #include "vendor_raw.h"
+#include "cowimage.h"
 
 #include <stdexcept>
 
+#include <dng_pixel_buffer.h>
+#include <dng_tag_types.h>
 #include <dng_simple_image.h>
 #include <dng_camera_profile.h>
 #include <dng_file_stream.h>
@@ -37,16 +40,48 @@
 #include <libraw/libraw.h>
 
 
-VendorRawProcessor::VendorRawProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
-    RawExiv2Processor(host, filename, inputImage),
+VendorRawProcessor::VendorRawProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor):
+    RawExiv2Processor(host, filename, inputStream, inputImage),
     m_RawProcessor(rawProcessor)
 {
     m_negative.Reset(m_host->Make_dng_negative());
 }
 
 
-VendorRawProcessor::~VendorRawProcessor() {
-	m_RawProcessor->recycle();
+// LibRaw's destructor recycles, but only once no image needs the buffer anymore
+VendorRawProcessor::~VendorRawProcessor() {}
+
+
+void VendorRawProcessor::buildDNGImage() {
+    libraw_image_sizes_t *sizes = getSizeInfo();
+    uint32 inputPlanes = getInputPlanes();
+    uint32 outputPlanes = (inputPlanes == 1) ? 1 : getImageParams()->colors;
+
+    // rows might be padded (raw_pitch is in bytes)
+    uint32 rowStep = (sizes->raw_pitch != 0) ? sizes->raw_pitch / sizeof(unsigned short) : sizes->raw_width * inputPlanes;
+
+    // View of the interleaved buffer, with more buffer planes than image planes the extra ones are skipped
+    dng_pixel_buffer buffer;
+    buffer.fArea = dng_rect(sizes->raw_height, sizes->raw_width);
+    buffer.fPlane = 0;
+    buffer.fPlanes = outputPlanes;
+    buffer.fRowStep = rowStep;
+    buffer.fColStep = inputPlanes;
+    buffer.fPlaneStep = 1;
+    buffer.fPixelType = ttShort;
+    buffer.fPixelSize = TagTypeSize(ttShort);
+    buffer.fData = getRawBuffer();
+
+    // LibRaw's memory manager doesn't allow taking over single buffers, so the image shares
+    // ownership of the whole LibRaw object. Clones share it as well until they are written to.
+    AutoPtr<dng_image> image(new CowImage(buffer, m_RawProcessor, m_host->Allocator()));
+    m_negative->SetStage1Image(image);
+}
+
+
+void VendorRawProcessor::releaseRawData() {
+    // only if there is no image (stage 1 or its clone) left that still views the buffer
+    if (m_RawProcessor.use_count() == 1) m_RawProcessor->recycle();
 }
 
 
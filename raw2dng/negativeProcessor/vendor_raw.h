@@ -21,6 +21,8 @@
 
 #include "rawexiv.h"
 
+#include <memory>
+
 
 class LibRaw;
 
@@ -28,13 +30,19 @@ class VendorRawProcessor : public RawExiv2Processor
 {
 public:
     ~VendorRawProcessor();
+
+    // Hands LibRaw's unpacked buffer to the negative without copying it
+    void buildDNGImage() override;
+    void releaseRawData() override;
+
 protected:
-    VendorRawProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
+    VendorRawProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage, LibRaw *rawProcessor);
     libraw_image_sizes_t* getSizeInfo() override;
     libraw_iparams_t* getImageParams() override;
     libraw_colordata_t* getColorData() override;
     unsigned short* getRawBuffer() override;
     uint32 getInputPlanes() override;
 
-    AutoPtr<LibRaw> m_RawProcessor;
+    // shared with the stage 1 image (and its clones), which keep LibRaw and its raw buffer alive
+    std::shared_ptr<LibRaw> m_RawProcessor;
 };
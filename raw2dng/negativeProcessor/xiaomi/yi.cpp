@@ -4,12 +4,11 @@
 #include "yi.h"
 #include <vector>
 #include <iostream>
-#include <fstream>
 #include <cmath>
 
 
-XiaomiYiProcessor::XiaomiYiProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage):
-    RawExiv2Processor(host, filename, inputImage)
+XiaomiYiProcessor::XiaomiYiProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage):
+    RawExiv2Processor(host, filename, inputStream, inputImage)
 {
     // bootstrapping libraw_.*_t with fixed values
     image_sizes.width = 4608;
@@ -96,16 +95,17 @@ uint32 XiaomiYiProcessor::getInputPlanes()
 }
 
 
+void XiaomiYiProcessor::releaseRawData()
+{
+    // the stage 1 image has its own copy
+    std::vector<unsigned short>().swap(bayerData);
+}
+
+
 void XiaomiYiProcessor::loadBayerData()
 {
-    std::ifstream file(m_inputFileName, std::ios::binary | std::ios::ate);
-    std::streamsize filesize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    bayerData.clear();
-    unsigned short pixelVal;
-    while (file.read((char*) &pixelVal, sizeof(unsigned short)))
-    {
-        bayerData.push_back(pixelVal);
-    }
+    // The file is nothing but the sensor data, read straight from the mapped input
+    const unsigned short *pixels = reinterpret_cast<const unsigned short*>(m_inputStream->Data());
+    bayerData.assign(pixels, pixels + m_inputStream->Size() / sizeof(unsigned short));
     printf("Successfully loaded %d pixel values", bayerData.size());
 }
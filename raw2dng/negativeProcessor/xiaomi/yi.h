@@ -27,13 +27,14 @@ class XiaomiYiProcessor : public RawExiv2Processor
 {
 friend class NegativeProcessor;
 protected:
-    XiaomiYiProcessor(AutoPtr<dng_host> &host, std::string filename, Exiv2::Image::AutoPtr &inputImage);
+    XiaomiYiProcessor(AutoPtr<dng_host> &host, std::string filename, MmapStream *inputStream, Exiv2::Image::AutoPtr &inputImage);
     libraw_image_sizes_t* getSizeInfo() override;
     libraw_iparams_t* getImageParams() override;
     libraw_colordata_t* getColorData() override;
     unsigned short* getRawBuffer() override;
     uint32 getInputPlanes() override;
     virtual void loadBayerData();
+    void releaseRawData() override;
 
     std::vector<unsigned short> bayerData;
     libraw_image_sizes_t image_sizes;
@@ -17,10 +17,27 @@
 */
 
 #include <stdexcept>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <iomanip>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <exiv2/xmp.hpp>
 
 #include "raw2dng.h"
 #include "rawConverter.h"
 
+#include "dng_mutex.h"
+#include "poolallocator.h"
+
 
 void publishProgressUpdate(const char *message) {std::cout << " - " << message << "...\n";}
 
@@ -32,8 +49,8 @@ void raw2dng(std::string rawFilename, std::string outFilename, std::string dcpFi
     RawConverter converter;
     converter.openRawFile(rawFilename);
     converter.buildNegative(dcpFilename);
-    if (embedOriginal) converter.embedRaw(rawFilename);
-    converter.renderImage();
+    if (embedOriginal) converter.embedRaw();
+    converter.renderImage(true);
     converter.renderPreviews();
     converter.writeDng(outFilename);
 }
@@ -42,7 +59,7 @@ void raw2dngMerge(std::string rawFilename, std::string outFilename, std::string
     RawConverter converter;
     converter.openRawFile(rawFilename, greenFilename, blueFilename);
     converter.buildNegative(dcpFilename);
-    converter.renderImage();
+    converter.renderImage(true);
     converter.renderPreviews();
     converter.writeDng(outFilename);
 }
@@ -52,7 +69,7 @@ void xiaomi_raw2dng(std::string rawFilename, std::string jpgFilename, std::strin
     RawConverter converter;
     converter.openRawFile(rawFilename, jpgFilename);
     converter.buildNegative(dcpFilename);
-    converter.renderImage();
+    converter.renderImage(true);
     converter.renderPreviews();
     converter.writeDng(outFilename);
 }
@@ -77,11 +94,223 @@ void raw2jpeg(std::string rawFilename, std::string outFilename, std::string dcpF
 }
 
 
+struct ConversionOptions {
+    std::string outPath;
+    std::string dcpFilename;
+    std::string jpgFilename;
+    std::string greenFilename;
+    std::string blueFilename;
+    bool embedOriginal = false, isJpeg = false, isTiff = false;
+};
+
+
+bool isDirectory(const std::string &path) {
+    struct stat info;
+    return (stat(path.c_str(), &info) == 0) && S_ISDIR(info.st_mode);
+}
+
+
+void addDirectoryFiles(const std::string &dirname, std::vector<std::string> &files) {
+    DIR *dir = opendir(dirname.c_str());
+    if (dir == NULL) throw std::runtime_error("Cannot open directory " + dirname);
+
+    std::vector<std::string> entries;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        std::string path = dirname + "/" + entry->d_name;
+        struct stat info;
+        if ((stat(path.c_str(), &info) == 0) && S_ISREG(info.st_mode)) entries.push_back(path);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end());
+    files.insert(files.end(), entries.begin(), entries.end());
+}
+
+
+void addListedFiles(const std::string &listFilename, std::vector<std::string> &files) {
+    std::ifstream listFile;
+    if (listFilename != "-") {
+        listFile.open(listFilename.c_str());
+        if (!listFile) throw std::runtime_error("Cannot open file list " + listFilename);
+    }
+    std::istream &list = (listFilename == "-") ? std::cin : listFile;
+
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (!line.empty()) files.push_back(line);
+    }
+}
+
+
+// Output filename: if not given, replace the raw file extension. In batch mode outPath is a directory.
+std::string buildOutFilename(const std::string &rawFilename, const ConversionOptions &options, bool isBatch) {
+    if (!isBatch && !options.outPath.empty()) return options.outPath;
+
+    std::string outFilename(rawFilename, 0, rawFilename.find_last_of("."));
+    if (isBatch && !options.outPath.empty()) {
+        size_t found = outFilename.find_last_of("/");
+        if (found != std::string::npos) outFilename.erase(0, found + 1);
+        outFilename = options.outPath + "/" + outFilename;
+    }
+
+    if (options.isJpeg)      outFilename.append(".jpg");
+    else if (options.isTiff) outFilename.append(".tif");
+    else                     outFilename.append(".dng");
+    return outFilename;
+}
+
+
+void convertFile(const std::string &rawFilename, const std::string &outFilename, const ConversionOptions &options) {
+    if (options.isJpeg)      raw2jpeg(rawFilename, outFilename, options.dcpFilename);
+    else if (options.isTiff) raw2tiff(rawFilename, outFilename, options.dcpFilename);
+    else if (!options.greenFilename.empty() || !options.blueFilename.empty())
+        raw2dngMerge(rawFilename, outFilename, options.dcpFilename, options.greenFilename, options.blueFilename);
+    else if (options.jpgFilename.empty()) raw2dng(rawFilename, outFilename, options.dcpFilename, options.embedOriginal);
+    else xiaomi_raw2dng(rawFilename, options.jpgFilename, outFilename, options.dcpFilename);
+}
+
+
+// Exiv2's bundled XMP toolkit is not thread-safe unless it is given a lock
+void exiv2XmpLock(void *lockData, bool lockUnlock) {
+    std::recursive_mutex *mutex = static_cast<std::recursive_mutex*>(lockData);
+    if (lockUnlock) mutex->lock(); else mutex->unlock();
+}
+
+
+void publishLockContention(const char *mutexName, uint64 count, void *context) {
+    std::cout << "    lock contention: " << mutexName << " (" << count << " times)\n";
+}
+
+
+int convertBatch(const std::vector<std::string> &rawFilenames, const ConversionOptions &options, uint32 workerCount) {
+    static std::recursive_mutex exiv2XmpMutex;
+    Exiv2::XmpParser::initialize(exiv2XmpLock, &exiv2XmpMutex);
+
+    // keep the XMP SDK alive for the whole batch instead of per converted file
+    RawConverter::acquireXmpSdk();
+
+    // Settle all output names before any worker starts: files that would write the same output
+    // (a/IMG_1.ARW and b/IMG_1.ARW with -o, IMG_1.CR2 next to IMG_1.JPG) or overwrite one of the
+    // inputs must fail, or they'd be written concurrently
+    std::vector<std::string> outFilenames(rawFilenames.size()), errors(rawFilenames.size());
+    std::set<std::string> inputs(rawFilenames.begin(), rawFilenames.end());
+    std::map<std::string, size_t> writers;
+    for (size_t index = 0; index < rawFilenames.size(); index++) {
+        outFilenames[index] = buildOutFilename(rawFilenames[index], options, true);
+        auto writer = writers.insert(std::make_pair(outFilenames[index], index));
+        if (!writer.second) {
+            size_t other = writer.first->second;
+            errors[index] = "output file \"" + outFilenames[index] + "\" is also written for \"" + rawFilenames[other] + "\"";
+            if (errors[other].empty()) errors[other] = "output file \"" + outFilenames[index] + "\" is also written for \"" + rawFilenames[index] + "\"";
+        }
+        else if (inputs.count(outFilenames[index]) != 0) errors[index] = "output file would overwrite an input file";
+    }
+
+    std::atomic<size_t> nextFile(0);
+    std::atomic<uint32> failedFiles(0);
+    std::mutex outputMutex;
+
+    auto worker = [&]() {
+        for (size_t index = nextFile++; index < rawFilenames.size(); index = nextFile++) {
+            const std::string &rawFilename = rawFilenames[index];
+            const std::string &outFilename = outFilenames[index];
+            std::time_t startTime = std::time(NULL);
+
+            try {
+                if (!errors[index].empty()) throw std::runtime_error(errors[index]);
+                convertFile(rawFilename, outFilename, options);
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << "Converted: \"" << rawFilename << "\" -> \"" << outFilename << "\" ("
+                          << std::difftime(std::time(NULL), startTime) << " seconds)\n";
+            }
+            catch (std::exception& e) {
+                failedFiles++;
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "Error! \"" << rawFilename << "\" (" << e.what() << ")\n";
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32 i = 1; i < std::min<size_t>(workerCount, rawFilenames.size()); i++) workers.push_back(std::thread(worker));
+    worker();
+    for (auto& workerThread : workers) workerThread.join();
+
+    RawConverter::releaseXmpSdk();
+    Exiv2::XmpParser::terminate();
+
+    std::cout << "--> Converted " << (rawFilenames.size() - failedFiles) << " of " << rawFilenames.size() << " files\n";
+    PoolAllocator::Statistics memory = PoolAllocator::Shared().GetStatistics();
+    std::cout << "--> Memory: " << (memory.peakLiveBytes >> 20) << " MiB peak, " << (memory.cachedBytes >> 20) << " MiB cached, "
+              << memory.hits << " of " << (memory.hits + memory.misses) << " allocations reused\n";
+    dng_mutex::ReportContention(publishLockContention, NULL);
+    std::cout << "\n";
+
+    return (failedFiles == 0) ? 0 : -1;
+}
+
+
+int benchmarkEmbedding(const std::vector<std::string> &rawFilenames) {
+    for (const auto &rawFilename : rawFilenames) {
+        std::cout << "Embedding \"" << rawFilename << "\":\n";
+        try {
+            for (int level = 1; level <= 9; level++) {
+                RawConverter::EmbedBenchmark result = RawConverter::benchmarkEmbedding(rawFilename, level);
+                std::cout << "  level " << level << ": "
+                          << std::fixed << std::setprecision(1) << (result.originalSize / 1e6 / result.seconds) << " MB/s, ratio "
+                          << std::setprecision(3) << (result.originalSize > 0 ? static_cast<double>(result.compressedSize) / result.originalSize : 1.0)
+                          << " (" << result.compressedSize << " of " << result.originalSize << " bytes)\n";
+            }
+        }
+        catch (std::exception& e) {
+            std::cerr << "Error! \"" << rawFilename << "\" (" << e.what() << ")\n";
+            return -1;
+        }
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+
+int benchmarkRenderLut(const std::vector<std::string> &rawFilenames, const ConversionOptions &options, uint32 lutSize) {
+    for (const auto &rawFilename : rawFilenames) {
+        std::cout << "Rendering \"" << rawFilename << "\" through a " << lutSize << "^3 LUT:\n";
+        try {
+            RawConverter converter;
+            converter.openRawFile(rawFilename);
+            converter.buildNegative(options.dcpFilename);
+            converter.renderImage();
+
+            RawConverter::LutBenchmark result = converter.benchmarkRenderLut(lutSize);
+            if (!result.usesLut) {
+                std::cout << "  not used: the profile has no hue/sat map or look table, exact rendering is faster\n";
+                continue;
+            }
+            std::cout << std::fixed << std::setprecision(3)
+                      << "  exact " << result.exactSeconds << " s, LUT " << result.lutSeconds << " s ("
+                      << result.firstLutSeconds << " s the first time, which builds it unless cached)\n"
+                      << "  colour difference (CIEDE2000): mean " << result.meanDeltaE << ", 99th percentile "
+                      << result.percentile99DeltaE << ", max " << result.maxDeltaE << "\n";
+        }
+        catch (std::exception& e) {
+            std::cerr << "Error! \"" << rawFilename << "\" (" << e.what() << ")\n";
+            return -1;
+        }
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+
 int main(int argc, const char* argv []) {  
     if (argc == 1) {
         std::cerr << "\n"
                      "raw2dng - DNG converter\n"
-                     "Usage: " << argv[0] << " [options] <rawfile>\n"
+                     "Usage: " << argv[0] << " [options] <rawfile|directory> [<rawfile|directory> ...]\n"
                      "Valid options:\n"
                      "  -dcp <filename>      use adobe camera profile\n"
                      "  -e                   embed original\n"
@@ -90,62 +319,108 @@ int main(int argc, const char* argv []) {
                      "  -t                   convert to TIFF instead of DNG\n"
                      "  -g <filename>        specify DNG file with green channel data to use (works only when processing DNG)\n"
                      "  -b <filename>        specify DNG file with blue channel data to use (works only when processing DNG)\n"
-                     "  -o <filename>        specify output filename\n\n";
+                     "  -o <filename>        specify output filename (output directory when converting several files)\n"
+                     "  -l <filename>        read list of input files from file, one per line ('-' for stdin)\n"
+                     "  -p <number>          number of files converted in parallel (default: number of cores)\n"
+                     "  -c <number>          number of threads used per file (default: number of cores)\n"
+                     "  -f                   fast raw compression: Huffman tables from a sample of rows, slightly larger DNG\n"
+                     "  -tile <pixels>       tile size of the raw image in the DNG, 16 to 16384 (default: picked from image size and threads)\n"
+                     "  -z <level>           compression level of the embedded original, 1 (fastest) to 9 (smallest, default: 6)\n"
+                     "  -zbench              compare compression speed and ratio of all levels on the given files and exit\n"
+                     "  -lut <points>        render previews, JPEGs and TIFFs through a 3D LUT with points^3 entries (2 to 129,\n"
+                     "                       e.g. 33 or 65; default 0 renders exactly), cached per camera profile; only for\n"
+                     "                       profiles with hue/sat maps\n"
+                     "  -lutbench            compare LUT and exact rendering (speed and CIEDE2000) on the given files and exit\n\n";
         return -1;
     }
 
     // -----------------------------------------------------------------------------------------
     // Parse command line
 
-    std::string outFilename;
-    std::string dcpFilename;
-    std::string jpgFilename;
-    std::string greenFilename;
-    std::string blueFilename;
-    bool embedOriginal = false, isJpeg = false, isTiff = false;
+    ConversionOptions options;
+    std::vector<std::string> rawFilenames;
+    uint32 workerCount = std::max(1u, std::thread::hardware_concurrency());
+    uint32 lutSize = 0;
+    bool isBatch = false, isEmbedBenchmark = false, isLutBenchmark = false;
 
     int index;
     for (index = 1; index < argc && argv [index][0] == '-'; index++) {
         std::string option = &argv[index][1];
-        if (0 == strcmp(option.c_str(), "o"))   outFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "dcp")) dcpFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "a7")) jpgFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "g"))   greenFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "b"))   blueFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "e"))   embedOriginal = true;
-        if (0 == strcmp(option.c_str(), "j"))   isJpeg = true;
-        if (0 == strcmp(option.c_str(), "t"))   isTiff = true;
+        if (0 == strcmp(option.c_str(), "o"))   options.outPath = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "dcp")) options.dcpFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "a7"))  options.jpgFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "g"))   options.greenFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "b"))   options.blueFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "e"))   options.embedOriginal = true;
+        if (0 == strcmp(option.c_str(), "j"))   options.isJpeg = true;
+        if (0 == strcmp(option.c_str(), "t"))   options.isTiff = true;
+        if (0 == strcmp(option.c_str(), "p"))   workerCount = std::max(1, atoi(argv[++index]));
+        if (0 == strcmp(option.c_str(), "c"))   RawConverter::setThreadCount(std::max(0, atoi(argv[++index])));
+        if (0 == strcmp(option.c_str(), "f"))   RawConverter::setFastRawCompression(true);
+        if (0 == strcmp(option.c_str(), "tile")) {
+            try {RawConverter::setRawTileSize(static_cast<uint32>(atoi(argv[++index])));}
+            catch (std::exception& e) {std::cerr << e.what() << "\n"; return 1;}
+        }
+        if (0 == strcmp(option.c_str(), "z")) {
+            try {RawConverter::setEmbedCompressionLevel(atoi(argv[++index]));}
+            catch (std::exception& e) {std::cerr << e.what() << "\n"; return 1;}
+        }
+        if (0 == strcmp(option.c_str(), "zbench")) isEmbedBenchmark = true;
+        if (0 == strcmp(option.c_str(), "lut")) {
+            lutSize = static_cast<uint32>(atoi(argv[++index]));
+            try {RawConverter::setRenderLutSize(lutSize);}
+            catch (std::exception& e) {std::cerr << e.what() << "\n"; return 1;}
+        }
+        if (0 == strcmp(option.c_str(), "lutbench")) isLutBenchmark = true;
+        if (0 == strcmp(option.c_str(), "l")) {
+            try {addListedFiles(std::string(argv[++index]), rawFilenames);}
+            catch (std::exception& e) {std::cerr << e.what() << "\n"; return 1;}
+            isBatch = true;
+        }
+    }
+
+    for (; index < argc; index++) {
+        std::string filename(argv[index]);
+        if (isDirectory(filename)) {
+            try {addDirectoryFiles(filename, rawFilenames);}
+            catch (std::exception& e) {std::cerr << e.what() << "\n"; return 1;}
+            isBatch = true;
+        }
+        else rawFilenames.push_back(filename);
     }
+    if (rawFilenames.size() > 1) isBatch = true;
 
-    if (index == argc) {
+    if (rawFilenames.empty()) {
         std::cerr << "No file specified\n";
         return 1;
     }
 
-    std::string rawFilename(argv[index++]);
-
-    // set output filename: if not given in command line, replace raw file extension
-    if (outFilename.empty()) {
-        outFilename.assign(rawFilename, 0, rawFilename.find_last_of("."));
-        if (isJpeg)      outFilename.append(".jpg");
-        else if (isTiff) outFilename.append(".tif");
-        else             outFilename.append(".dng");
-    }
+    if (isEmbedBenchmark) return benchmarkEmbedding(rawFilenames);
+    if (isLutBenchmark) return benchmarkRenderLut(rawFilenames, options, (lutSize != 0) ? lutSize : 33);
 
     // -----------------------------------------------------------------------------------------
     // Call the conversion function
 
+    if (isBatch) {
+        std::cout << "Starting batch conversion: " << rawFilenames.size() << " files, " << workerCount << " in parallel\n";
+        std::time_t startTime = std::time(NULL);
+
+        int result = convertBatch(rawFilenames, options, workerCount);
+
+        std::cout << "--> Done (" << std::difftime(std::time(NULL), startTime) << " seconds)\n\n";
+        return result;
+    }
+
+    std::string rawFilename(rawFilenames[0]);
+    std::string outFilename(buildOutFilename(rawFilename, options, false));
+
     std::cout << "Starting conversion: \"" << rawFilename << "\n";
     std::time_t startTime = std::time(NULL);
 
     RawConverter::registerPublisher(publishProgressUpdate);
 
     try {
-        if (isJpeg)      raw2jpeg(rawFilename, outFilename, dcpFilename);
-        else if (isTiff) raw2tiff(rawFilename, outFilename, dcpFilename);
-        else if (!greenFilename.empty() || !blueFilename.empty()) raw2dngMerge(rawFilename, outFilename, dcpFilename, greenFilename, blueFilename);
-        else if (jpgFilename.empty()) raw2dng (rawFilename, outFilename, dcpFilename, embedOriginal);
-        else xiaomi_raw2dng(rawFilename, jpgFilename, outFilename, dcpFilename);
+        convertFile(rawFilename, outFilename, options);
     }
     catch (std::exception& e) {
         std::cerr << "--> Error! (" << e.what() << ")\n\n";
@@ -20,12 +20,12 @@
 #include "rawConverter.h"
 
 #include <stdexcept>
+#include <chrono>
 
 #include "dng_negative.h"
 #include "dng_preview.h"
 #include "dng_xmp_sdk.h"
 #include "dng_memory_stream.h"
-#include "dng_file_stream.h"
 #include "dng_render.h"
 #include "dng_image_writer.h"
 #include "dng_color_space.h"
@@ -37,13 +37,28 @@
 
 #include "negativeProcessor/processor.h"
 #include "dnghost.h"
+#include "dngimagewriter.h"
+#include "pyramidrender.h"
+#include "renderlut.h"
+#include "poolallocator.h"
+#include "mmapstream.h"
 
 
 std::function<void(const char*)> RawConverter::m_publishFunction = NULL;
+uint32 RawConverter::m_threadCount = 0;
+int RawConverter::m_embedCompressionLevel = NegativeProcessor::kDefaultCompressionLevel;
+uint32 RawConverter::m_rawTileSize = 0;
+bool RawConverter::m_fastRawCompression = false;
+uint32 RawConverter::m_renderLutSize = 0;
 
+const uint32 kPreviewSize   = 1024;
+const uint32 kThumbnailSize = 256;
+std::mutex RawConverter::m_xmpSdkMutex;
+uint32 RawConverter::m_xmpSdkUsers = 0;
 
-dng_file_stream* openFileStream(const std::string &outFilename) {
-    try {return new dng_file_stream(outFilename.c_str(), true);}
+
+PwriteStream* openFileStream(const std::string &outFilename) {
+    try {return new PwriteStream(outFilename.c_str());}
     catch (dng_exception& e) {
         std::stringstream error; error << "Error opening output file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
@@ -55,9 +70,14 @@ RawConverter::RawConverter() {
     // -----------------------------------------------------------------------------------------
     // Init XMP SDK and some global variables we will need
 
-    dng_xmp_sdk::InitializeSDK();
+    acquireXmpSdk();
+
+    // Share one pooling allocator between all converters, so that tile buffers and stage images
+    // of the same size are reused across files (and the threads processing them)
+    DngHost *host = new DngHost(&PoolAllocator::Shared());
+    host->SetThreadCount(m_threadCount);
 
-    m_host.Reset(dynamic_cast<dng_host*>(new DngHost()));
+    m_host.Reset(dynamic_cast<dng_host*>(host));
     m_host->SetSaveDNGVersion(dngVersion_SaveDefault);
     m_host->SetSaveLinearDNG(false);
     m_host->SetKeepOriginalFile(true);
@@ -69,7 +89,78 @@ RawConverter::RawConverter() {
 
 
 RawConverter::~RawConverter() {
-    dng_xmp_sdk::TerminateSDK();
+    // make sure all SDK objects are gone before the XMP SDK might be terminated
+    m_previewList.Reset();
+    m_negProcessor.Reset();
+    m_host.Reset();
+
+    releaseXmpSdk();
+}
+
+
+void RawConverter::setThreadCount(uint32 threadCount) {
+    m_threadCount = threadCount;
+}
+
+
+void RawConverter::setRawTileSize(uint32 rawTileSize) {
+    if (rawTileSize != 0 && (rawTileSize < 16 || rawTileSize > 16384))
+        throw std::runtime_error("Tile size must be between 16 and 16384!");
+    m_rawTileSize = rawTileSize;
+}
+
+
+void RawConverter::setFastRawCompression(bool fastRawCompression) {
+    m_fastRawCompression = fastRawCompression;
+}
+
+
+void RawConverter::setRenderLutSize(uint32 lutSize) {
+    if (lutSize == 1 || lutSize > RenderLut::kMaxGridSize)
+        throw std::runtime_error("LUT size must be between 2 and 129!");
+    m_renderLutSize = lutSize;
+}
+
+
+void RawConverter::setEmbedCompressionLevel(int compressionLevel) {
+    if (compressionLevel < 1 || compressionLevel > 9)
+        throw std::runtime_error("Compression level must be between 1 and 9!");
+    m_embedCompressionLevel = compressionLevel;
+}
+
+
+RawConverter::EmbedBenchmark RawConverter::benchmarkEmbedding(const std::string rawFilename, int compressionLevel) {
+    DngHost host(&PoolAllocator::Shared());
+    host.SetThreadCount(m_threadCount);
+
+    AutoPtr<MmapStream> rawDataStream(openInputFile(rawFilename));
+
+    // fault the mapping in first, so that only compression is timed
+    volatile uint8 sum = 0;
+    for (uint64 offset = 0; offset < rawDataStream->Size(); offset += 4096) sum += rawDataStream->Data()[offset];
+
+    auto startTime = std::chrono::steady_clock::now();
+    dng_fingerprint digest;
+    AutoPtr<dng_memory_block> block(NegativeProcessor::compressOriginalFile(host, rawDataStream->Data(), rawDataStream->Size(), compressionLevel, digest));
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - startTime;
+
+    EmbedBenchmark result;
+    result.originalSize = rawDataStream->Size();
+    result.compressedSize = block->LogicalSize();
+    result.seconds = duration.count();
+    return result;
+}
+
+
+void RawConverter::acquireXmpSdk() {
+    std::lock_guard<std::mutex> lock(m_xmpSdkMutex);
+    if (m_xmpSdkUsers++ == 0) dng_xmp_sdk::InitializeSDK();
+}
+
+
+void RawConverter::releaseXmpSdk() {
+    std::lock_guard<std::mutex> lock(m_xmpSdkMutex);
+    if (--m_xmpSdkUsers == 0) dng_xmp_sdk::TerminateSDK();
 }
 
 
@@ -133,23 +224,36 @@ void RawConverter::buildNegative(const std::string dcpFilename) {
 }
 
 
-void RawConverter::embedRaw(const std::string rawFilename) {
+void RawConverter::embedRaw() {
     if (m_publishFunction != NULL) m_publishFunction("embedding raw file");
-    m_negProcessor->embedOriginalFile(rawFilename.c_str());
+    m_negProcessor->embedOriginalFile(m_embedCompressionLevel);
 }
 
 
-void RawConverter::renderImage() {
+void RawConverter::renderImage(bool previewOnly) {
     // -----------------------------------------------------------------------------------------
     // Render image
 
+    // Preview sizes must not stick to the host for later renders, also when this one fails
+    struct ResetPreviewSettings {
+        dng_host &host;
+        ~ResetPreviewSettings() {host.SetMinimumSize(0); host.SetPreferredSize(0); host.SetForPreview(false);}
+    } resetPreviewSettings = {*m_host};
+
     try {
         if (m_publishFunction != NULL) m_publishFunction("building preview - linearising");
 
         m_negProcessor->getNegative()->BuildStage2Image(*m_host);   // Compute linearized and range-mapped image
+        m_negProcessor->releaseRawData();                           // Free input data the negative doesn't reference anymore
 
         if (m_publishFunction != NULL) m_publishFunction("building preview - demosaicing");
 
+        if (previewOnly) {
+            m_host->SetMinimumSize(kPreviewSize);
+            m_host->SetPreferredSize(kPreviewSize);
+            m_host->SetForPreview(true);
+        }
+
         m_negProcessor->getNegative()->BuildStage3Image(*m_host);   // Compute demosaiced image (used by preview and thumbnail)
     }
     catch (dng_exception& e) {
@@ -164,9 +268,13 @@ void RawConverter::renderPreviews() {
     // Render JPEG and thumbnail previews
 
     m_previewList.Reset(new dng_preview_list());
-    dng_render negRender(*m_host, *m_negProcessor->getNegative());
 
-    if (m_publishFunction != NULL) m_publishFunction("building preview - rendering JPEG");
+    if (m_publishFunction != NULL) m_publishFunction("building preview - rendering JPEG and thumbnail");
+
+    // Renders once at preview size, the thumbnail is scaled down from the rendered preview
+    PyramidRender negRender(*m_host, *m_negProcessor->getNegative());
+    negRender.SetLutSize(m_renderLutSize);
+    std::vector<std::unique_ptr<dng_image>> negImages(negRender.RenderSizes({kPreviewSize, kThumbnailSize}));
 
     dng_jpeg_preview *jpeg_preview = new dng_jpeg_preview();
     jpeg_preview->fInfo.fApplicationName.Set_ASCII(m_appName.Get());
@@ -174,37 +282,69 @@ void RawConverter::renderPreviews() {
     jpeg_preview->fInfo.fDateTime = m_dateTimeNow.Encode_ISO_8601();
     jpeg_preview->fInfo.fColorSpace = previewColorSpace_sRGB;
 
-    negRender.SetMaximumSize(1024);
-    AutoPtr<dng_image> negImage(negRender.Render());
-    dng_image_writer jpegWriter; jpegWriter.EncodeJPEGPreview(*m_host, *negImage.Get(), *jpeg_preview, 5);
+    dng_image_writer jpegWriter; jpegWriter.EncodeJPEGPreview(*m_host, *negImages[0], *jpeg_preview, 5);
     AutoPtr<dng_preview> jp(dynamic_cast<dng_preview*>(jpeg_preview));
     m_previewList->Append(jp);
 
-    if (m_publishFunction != NULL) m_publishFunction("building preview - rendering thumbnail");
-
     dng_image_preview *thumbnail = new dng_image_preview();
     thumbnail->fInfo.fApplicationName    = jpeg_preview->fInfo.fApplicationName;
     thumbnail->fInfo.fApplicationVersion = jpeg_preview->fInfo.fApplicationVersion;
     thumbnail->fInfo.fDateTime           = jpeg_preview->fInfo.fDateTime;
     thumbnail->fInfo.fColorSpace         = jpeg_preview->fInfo.fColorSpace;
 
-    negRender.SetMaximumSize(256);
-    thumbnail->fImage.Reset(negRender.Render());
+    thumbnail->fImage.Reset(negImages[1].release());
     AutoPtr<dng_preview> tn(dynamic_cast<dng_preview*>(thumbnail));
     m_previewList->Append(tn);
 }
 
 
+RawConverter::LutBenchmark RawConverter::benchmarkRenderLut(uint32 lutSize) {
+    const dng_negative &negative = *m_negProcessor->getNegative();
+    LutBenchmark result;
+
+    PyramidRender exactRender(*m_host, negative);
+    auto startTime = std::chrono::steady_clock::now();
+    AutoPtr<dng_image> exactImage(exactRender.Render());
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - startTime;
+    result.exactSeconds = duration.count();
+
+    PyramidRender lutRender(*m_host, negative);
+    lutRender.SetLutSize(lutSize);
+    result.usesLut = lutRender.UsesLut();
+
+    AutoPtr<dng_image> lutImage;
+    for (int pass = 0; pass < 2; pass++) {
+        startTime = std::chrono::steady_clock::now();
+        lutImage.Reset(lutRender.Render());
+        duration = std::chrono::steady_clock::now() - startTime;
+        if (pass == 0) result.firstLutSeconds = duration.count();
+        else result.lutSeconds = duration.count();
+    }
+
+    RenderLut::Difference difference = RenderLut::Compare(*exactImage, *lutImage, exactRender.FinalSpace());
+    result.meanDeltaE = difference.mean;
+    result.percentile99DeltaE = difference.percentile99;
+    result.maxDeltaE = difference.max;
+    return result;
+}
+
+
 void RawConverter::writeDng(const std::string outFilename) {
     // -----------------------------------------------------------------------------------------
     // Write DNG-image to file
 
     if (m_publishFunction != NULL) m_publishFunction("writing DNG file");
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    // Previews are rendered already, the DNG itself only contains the raw image
+    AutoPtr<dng_image> noImage;
+    m_negProcessor->getNegative()->SetStage3Image(noImage);
+
+    AutoPtr<PwriteStream> targetFile(openFileStream(outFilename));
 
     try {
-        dng_image_writer dngWriter; dngWriter.WriteDNG(*m_host, *targetFile, *m_negProcessor->getNegative(), m_previewList.Get());
+        DngImageWriter dngWriter(m_rawTileSize, m_fastRawCompression); dngWriter.WriteDNG(*m_host, *targetFile, *m_negProcessor->getNegative(), m_previewList.Get());
+        targetFile->Flush();
+        targetFile->Close();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing DNG-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
@@ -219,13 +359,14 @@ void RawConverter::writeTiff(const std::string outFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("rendering TIFF");
 
-    dng_render negRender(*m_host, *m_negProcessor->getNegative());
+    PyramidRender negRender(*m_host, *m_negProcessor->getNegative());
+    negRender.SetLutSize(m_renderLutSize);
     AutoPtr<dng_image> negImage(negRender.Render());
 
     // -----------------------------------------------------------------------------------------
     // Write Tiff-image to file
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    AutoPtr<PwriteStream> targetFile(openFileStream(outFilename));
 
     if (m_publishFunction != NULL) m_publishFunction("writing TIFF file");
 
@@ -234,6 +375,8 @@ void RawConverter::writeTiff(const std::string outFilename) {
         tiffWriter.WriteTIFF(*m_host, *targetFile, *negImage.Get(), piRGB, ccUncompressed,
                              m_negProcessor->getNegative(), &dng_space_sRGB::Get(), NULL,
                              dynamic_cast<const dng_jpeg_preview*>(&m_previewList->Preview(1)));
+        targetFile->Flush();
+        targetFile->Close();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing TIFF-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
@@ -250,7 +393,8 @@ void RawConverter::writeJpeg(const std::string outFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("rendering JPEG");
 
-    dng_render negRender(*m_host, *m_negProcessor->getNegative());
+    PyramidRender negRender(*m_host, *m_negProcessor->getNegative());
+    negRender.SetLutSize(m_renderLutSize);
     AutoPtr<dng_image> negImage(negRender.Render());
 
     AutoPtr<dng_jpeg_preview> jpeg(new dng_jpeg_preview());
@@ -266,7 +410,7 @@ void RawConverter::writeJpeg(const std::string outFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("writing JPEG file");
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    AutoPtr<PwriteStream> targetFile(openFileStream(outFilename));
 
     const uint8 soiTag[]         = {0xff, 0xd8};
     const uint8 app1Tag[]        = {0xff, 0xe1};
@@ -360,6 +504,7 @@ void RawConverter::writeJpeg(const std::string outFilename) {
         targetFile->Put((uint8*) jpeg->fCompressedData->Buffer() + jfifHeaderLength, jpeg->fCompressedData->LogicalSize() - jfifHeaderLength);
 
         targetFile->Flush();
+        targetFile->Close();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing JPEG-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
@@ -21,6 +21,7 @@
 #include "negativeProcessor/processor.h"
 
 #include <string>
+#include <mutex>
 
 #include "dng_auto_ptr.h"
 #include "dng_preview.h"
@@ -37,16 +38,60 @@ public:
    void openRawFile(const std::string rawFilename, const std::string xiaomiJpgFilename);
    void openRawFile(const std::string rawFilename, const std::string greenFilename, const std::string blueFilename);
    void buildNegative(const std::string dcpFilename);
-   void embedRaw(const std::string rawFilename);
-   void renderImage();
+   // Embeds the file opened with openRawFile (not the green/blue DNGs or the Xiaomi JPEG)
+   void embedRaw();
+   // With previewOnly the image is demosaiced at the smallest downscale that still covers the
+   // JPEG preview, which is all that's needed when only writing a DNG
+   void renderImage(bool previewOnly = false);
    void renderPreviews();
 
+   // Frees the demosaiced image first, which only served the previews: call it after the other writers
    void writeDng (const std::string outFilename);
    void writeTiff(const std::string outFilename);
    void writeJpeg(const std::string outFilename);
 
    static void registerPublisher(std::function<void(const char*)> function);
 
+   // Threads used per conversion for tile processing and (de-)compression, 0 for hardware concurrency
+   static void setThreadCount(uint32 threadCount);
+
+   // Edge length in pixels of the raw image's tiles in written DNGs, from 16 to 16384. 0 (default)
+   // picks the largest size that still gives every thread a few tiles to compress.
+   static void setRawTileSize(uint32 rawTileSize);
+
+   // Fast compression of the raw image in written DNGs: Huffman tables from a sample of rows,
+   // for slightly larger files
+   static void setFastRawCompression(bool fastRawCompression);
+
+   // Deflate level of the embedded original raw file, from 1 (fastest) to 9 (smallest)
+   static void setEmbedCompressionLevel(int compressionLevel);
+
+   // Renders previews, JPEGs and TIFFs through a 3D LUT with lutSize^3 points, built once per camera
+   // profile and settings and reused for all files of a batch. Only profiles with a hue/sat map or
+   // look table use it. 0 (default) renders exactly.
+   static void setRenderLutSize(uint32 lutSize);
+
+   // Renders the full image exactly and through the LUT, for comparing speed and colours.
+   // Call after renderImage().
+   struct LutBenchmark {
+      bool usesLut;
+      double exactSeconds, lutSeconds, firstLutSeconds;   // the first LUT render builds it, unless cached
+      double meanDeltaE, percentile99DeltaE, maxDeltaE;  // CIEDE2000
+   };
+   LutBenchmark benchmarkRenderLut(uint32 lutSize);
+
+   // Compresses a file the way embedRaw does (without converting it), for comparing levels
+   struct EmbedBenchmark {
+      uint64 originalSize, compressedSize;
+      double seconds;
+   };
+   static EmbedBenchmark benchmarkEmbedding(const std::string rawFilename, int compressionLevel);
+
+   // The XMP SDK is initialised by the first live converter and terminated with the last one.
+   // Batch callers can hold an extra reference so that it is only initialised once per process.
+   static void acquireXmpSdk();
+   static void releaseXmpSdk();
+
 private:
    AutoPtr<dng_host> m_host;
    AutoPtr<NegativeProcessor> m_negProcessor;
@@ -56,4 +101,12 @@ private:
    dng_date_time_info m_dateTimeNow;
 
    static std::function<void(const char*)> m_publishFunction;
+   static uint32 m_threadCount;
+   static int m_embedCompressionLevel;
+   static uint32 m_rawTileSize;
+   static bool m_fastRawCompression;
+   static uint32 m_renderLutSize;
+
+   static std::mutex m_xmpSdkMutex;
+   static uint32 m_xmpSdkUsers;
 };